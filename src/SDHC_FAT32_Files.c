@@ -710,20 +710,20 @@ int file_open(char *filename, file_descriptor *descrp) {
         // Get the first sector of the current cluster
         uint32_t first_sector_current_cluster = first_sector_of_cluster(current_cluster_number);
         // In my OS the "read" position on a newly opened file is always set to the begining of that file
-        (currentPCB->streams)[*descrp].position_fgetc = 0;
+        stream_get(currentPCB, *descrp)->position_fgetc = 0;
         // update the position_sector
-        (currentPCB->streams)[*descrp].position_sector = first_sector_current_cluster + cluster_sector_offset;
+        stream_get(currentPCB, *descrp)->position_sector = first_sector_current_cluster + cluster_sector_offset;
         // Update the stream position_in_sector
-        (currentPCB->streams)[*descrp].position_in_sector = bytes_after_sector_div;
+        stream_get(currentPCB, *descrp)->position_in_sector = bytes_after_sector_div;
     }
     else {
         // the file is new
         // initialize the position_fgetc
-        (currentPCB->streams)[*descrp].position_fgetc = 0;
+        stream_get(currentPCB, *descrp)->position_fgetc = 0;
         // initialize the position_sector
-        (currentPCB->streams)[*descrp].position_sector = 0;
+        stream_get(currentPCB, *descrp)->position_sector = 0;
         // initialize the stream position_in_sector
-        (currentPCB->streams)[*descrp].position_in_sector = 0;
+        stream_get(currentPCB, *descrp)->position_in_sector = 0;
     }
     return E_SUCCESS;
 }
@@ -731,17 +731,99 @@ int file_open(char *filename, file_descriptor *descrp) {
 int file_close(file_descriptor descrp)
 {
     // Update the Stream
-    (currentPCB->streams)[descrp].position_in_sector = 0;
-    (currentPCB->streams)[descrp].position_sector = 0;
+    stream_get(currentPCB, descrp)->position_in_sector = 0;
+    stream_get(currentPCB, descrp)->position_sector = 0;
     return E_SUCCESS;
 }
 
+/**
+ * Take a free cluster for the end of a chain. Unless FSI_Nxt_Free has a
+ * valid value the search starts at cluster 2, per spec.
+ * Returns: E_SUCCESS, or E_NO_FREE_CLUSTER
+ */
+static int cluster_alloc(uint32_t *clusterp)
+{
+    uint32_t cluster_search_index = 2;
+    if (FSI_Nxt_Free != FSI_NXT_FREE_UNKNOWN)
+    {
+        cluster_search_index = FSI_Nxt_Free;
+    }
+    // Traverse the FAT and check if there is a free cluster
+    while (cluster_search_index <= total_data_clusters + 1)
+    {
+        if (read_FAT_entry(rca, cluster_search_index) == FAT_ENTRY_FREE)
+        {
+            write_FAT_entry(rca, cluster_search_index, FAT_ENTRY_ALLOCATED_AND_END_OF_FILE);
+            *clusterp = cluster_search_index;
+            return E_SUCCESS;
+        }
+        cluster_search_index++;
+    }
+    return E_NO_FREE_CLUSTER;
+}
+
+/**
+ * Follow the FAT from cluster to the next cluster of its chain.
+ * Returns: E_SUCCESS, or E_EOF if cluster is the last in the chain
+ */
+static int cluster_next(uint32_t cluster, uint32_t *nextp)
+{
+    uint32_t next = read_FAT_entry(rca, cluster);
+    if (next == FAT_ENTRY_DEFECTIVE_CLUSTER)
+    {
+        // Fatal error
+        __BKPT();
+    }
+    if (next >= FAT_ENTRY_RESERVED_TO_END || next == FAT_ENTRY_FREE)
+    {
+        return E_EOF;
+    }
+    *nextp = next;
+    return E_SUCCESS;
+}
+
+/**
+ * Find the cluster holding byte offset of the file whose chain starts at
+ * first_cluster.
+ * Returns: E_SUCCESS, or E_EOF if the chain ends before offset
+ */
+static int cluster_at(uint32_t first_cluster, uint32_t offset, uint32_t *clusterp)
+{
+    uint32_t cluster = first_cluster;
+    for (uint32_t i = offset / (bytes_per_sector * sectors_per_cluster); i > 0; i--)
+    {
+        if (cluster_next(cluster, &cluster) != E_SUCCESS)
+        {
+            return E_EOF;
+        }
+    }
+    *clusterp = cluster;
+    return E_SUCCESS;
+}
+
+/**
+ * Returns: the sector holding byte offset of a file, given the cluster that
+ * holds it
+ */
+static uint32_t sector_at(uint32_t cluster, uint32_t offset)
+{
+    return first_sector_of_cluster(cluster) + (offset % (bytes_per_sector * sectors_per_cluster)) / bytes_per_sector;
+}
+
+/**
+ * Writes append to the end of the file and stop at the first null, a sector
+ * at a time. The end of the file is found from its size and the FAT rather
+ * than from the stream, so a write that crosses into a new sector or cluster
+ * needs no special case; a new cluster is chained on when the file fills
+ * the last one.
+ */
 int file_putbuf(file_descriptor descr, char *bufp, int buflen) {
     struct sdhc_card_status my_card_status;
+    Stream *stream = stream_get(currentPCB, descr);
     // Get the file entry sector and number
     uint32_t file_entry_sector;
     int file_entry_number;
-    int get_entry_status = dir_find_file_x(&(currentPCB->streams)[descr].pathname[1], &file_entry_sector, &file_entry_number);
+    int get_entry_status = dir_find_file_x(&stream->pathname[1], &file_entry_sector, &file_entry_number);
     if (get_entry_status != E_SUCCESS) {
         return get_entry_status;
     }
@@ -757,140 +839,97 @@ int file_putbuf(file_descriptor descr, char *bufp, int buflen) {
     }
     struct dir_entry_8_3 *dir_entry = ((struct dir_entry_8_3 *)entry_sector_data) + file_entry_number;
     uint32_t first_data_cluster = dir_entry->DIR_FstClusHI << 16 | dir_entry->DIR_FstClusLO;
-    /**
-     * Allocate the initial cluster if it's a new file
-     * Find a free cluster, or return an error. Unless FSI_Nxt_Free has a valid value, start at cluster 2 per spec
-     */
-    if (first_data_cluster == 0)
+    uint32_t bytes_per_cluster = bytes_per_sector * sectors_per_cluster;
+    // buflen counts the null terminator
+    uint32_t remaining = buflen > 0 ? strnlen(bufp, buflen - 1) : 0;
+    uint32_t cluster = 0; // the cluster holding the end of the file, once found
+    int status = E_SUCCESS;
+    uint8_t position_sector_data[512];
+    while (remaining > 0)
     {
-        uint32_t cluster_search_index = 2;
-        if (FSI_Nxt_Free != FSI_NXT_FREE_UNKNOWN)
+        uint32_t size = dir_entry->DIR_FileSize;
+        if (first_data_cluster == 0)
         {
-            cluster_search_index = FSI_Nxt_Free;
+            // A new file gets its first cluster on its first write
+            status = cluster_alloc(&first_data_cluster);
+            if (status != E_SUCCESS)
+            {
+                break;
+            }
+            dir_entry->DIR_FstClusHI = first_data_cluster >> 16;
+            dir_entry->DIR_FstClusLO = first_data_cluster & 0xFFFF;
+            cluster = first_data_cluster;
         }
-        // Traverse the FAT and check if there is a free cluster
-        while (cluster_search_index <= total_data_clusters + 1)
+        else if (cluster == 0)
         {
-            uint32_t cluster_fat_entry = read_FAT_entry(rca, cluster_search_index);
-            if (cluster_fat_entry == FAT_ENTRY_FREE)
+            // The cluster holding the last byte; an empty file's first one
+            status = cluster_at(first_data_cluster, size == 0 ? 0 : size - 1, &cluster);
+            if (status != E_SUCCESS)
             {
-                // Update the FAT
-                write_FAT_entry(rca, cluster_search_index, FAT_ENTRY_ALLOCATED_AND_END_OF_FILE);
-                // Update the stream's cluster number
-                first_data_cluster = cluster_search_index;
                 break;
             }
-            cluster_search_index++;
         }
-        if (first_data_cluster == 0) {
-            return E_NO_FREE_CLUSTER;
+        if (size > 0 && size % bytes_per_cluster == 0)
+        {
+            // The file fills its last cluster, so chain on another
+            uint32_t last = cluster;
+            status = cluster_alloc(&cluster);
+            if (status != E_SUCCESS)
+            {
+                break;
+            }
+            write_FAT_entry(rca, last, cluster);
         }
-        // Set first cluster high and low
-        dir_entry->DIR_FstClusHI = first_data_cluster >> 16;
-        dir_entry->DIR_FstClusLO = first_data_cluster & 0xFFFF;
-        // Write the updated sector data to the microSD
-        int write_status = sdhc_write_single_block(rca, file_entry_sector, &my_card_status, entry_sector_data);
-        if (write_status != SDHC_SUCCESS)
+        uint32_t sector = sector_at(cluster, size);
+        uint32_t in_sector = size % bytes_per_sector;
+        uint32_t chunk = bytes_per_sector - in_sector;
+        if (chunk > remaining)
+        {
+            chunk = remaining;
+        }
+        int data_read_status = sdhc_read_single_block(rca, sector, &my_card_status, position_sector_data);
+        if (data_read_status != SDHC_SUCCESS)
         {
             // Fatal error
             __BKPT();
         }
-        // Update the stream position_sector
-        (currentPCB->streams)[descr].position_sector = first_sector_of_cluster(first_data_cluster);
-    }
-    // Set the current cluster
-    uint32_t current_cluster_number = first_data_cluster;
-    // In my OS data is always appended to the end of a file
-    // Get the number of clusters in use via the file size
-    uint32_t file_num_clusters = dir_entry->DIR_FileSize / (bytes_per_sector * sectors_per_cluster);
-    if (file_num_clusters > 0)
-    {
-        uint32_t current_cluster_fat_entry = read_FAT_entry(rca, first_data_cluster);
-        // Traverse the FAT to take us to the last cluster for this file
-        for (int i = 0; i < file_num_clusters; i++)
+        memcpy(&position_sector_data[in_sector], bufp, chunk);
+        int data_write_status = sdhc_write_single_block(rca, sector, &my_card_status, position_sector_data);
+        if (data_write_status != SDHC_SUCCESS)
         {
-            uint32_t current_cluster_fat_entry = read_FAT_entry(rca, current_cluster_fat_entry);
-        }
-        current_cluster_number = current_cluster_fat_entry;
-    }
-    /**
-     * Write data to file
-     */
-    uint32_t write_len = buflen;
-    // First check if the amount of data we need to write will spill over into the next sector
-    uint32_t sector_start_offset = (currentPCB->streams)[descr].position_in_sector + buflen;
-    if (sector_start_offset > bytes_per_sector) {
-        // If so call this function recursively to handle the spillover
-        // But first check if a new cluster is needed, fml
-        // Get the number of bytes in-use in the last in-use cluster
-        uint32_t bytes_after_cluster_div = dir_entry->DIR_FileSize % (bytes_per_sector * sectors_per_cluster);
-        // Get the sector cluster index to see if we need a new cluster
-        uint32_t sector_cluster_index = bytes_after_cluster_div / bytes_per_sector;
-        if (sector_cluster_index == sectors_per_cluster-1) {
-            // Current sector is the last in the cluster
-            // Find a free cluster, or return an error. Unless FSI_Nxt_Free has a valid value, start at cluster 2 per spec
-            uint32_t cluster_search_index = 2;
-            if (FSI_Nxt_Free != FSI_NXT_FREE_UNKNOWN) {
-                cluster_search_index = FSI_Nxt_Free;
-            }
-            // Traverse the FAT and check if there is a free cluster
-            while (cluster_search_index <= total_data_clusters+1) {
-                uint32_t cluster_fat_entry = read_FAT_entry(rca, cluster_search_index);
-                if (cluster_fat_entry == FAT_ENTRY_FREE) {
-                    // Update the FAT
-                    write_FAT_entry(rca, current_cluster_number, cluster_search_index);
-                    write_FAT_entry(rca, cluster_search_index, FAT_ENTRY_ALLOCATED_AND_END_OF_FILE);
-                    current_cluster_number = cluster_search_index;
-                }
-                else {
-                    // Else return an error
-                    return E_NO_FREE_CLUSTER;
-                }
-            }
-        }
-        write_len = bytes_per_sector - (currentPCB->streams)[descr].position_in_sector;
-        char *spillover;
-        strncpy((char *)&spillover, &bufp[write_len], buflen - write_len);
-        int file_putbuf_status = file_putbuf(descr, spillover, buflen - write_len);
-        if (file_putbuf_status != E_SUCCESS) {
-            return file_putbuf_status;
+            // Fatal error
+            __BKPT();
         }
+        dir_entry->DIR_FileSize = size + chunk;
+        bufp += chunk;
+        remaining -= chunk;
+        stream->position_sector = sector;
+        stream->position_in_sector = in_sector + chunk;
     }
-    uint8_t position_sector_data[512];
-    // Read the current sector data
-    int data_read_status = sdhc_read_single_block(rca, (currentPCB->streams)[descr].position_sector, &my_card_status, position_sector_data);
-    if (data_read_status != SDHC_SUCCESS)
-    {
-        // Fatal error
-        __BKPT();
-    }
-    // Update the current sector data at the sector offset with buffer contents
-    strncpy((char *)&(position_sector_data[(currentPCB->streams)[descr].position_in_sector]), bufp, buflen);
-    int data_write_status = sdhc_write_single_block(rca, (currentPCB->streams)[descr].position_sector, &my_card_status, position_sector_data);
-    if (data_write_status != SDHC_SUCCESS)
-    {
-        // Fatal error
-        __BKPT();
-    }
-    // Update the stream position, subtract 1 to account for the null terminator
-    (currentPCB->streams)[descr].position_in_sector = (currentPCB->streams)[descr].position_in_sector + (buflen - 1);
-    dir_entry->DIR_FileSize = dir_entry->DIR_FileSize + buflen - 1;
-    // Write the updated entry sector data to the microSD
+    // Write the updated entry sector data to the microSD, even after a
+    // failure part way, so the size covers whatever was written
     int filesize_write_status = sdhc_write_single_block(rca, file_entry_sector, &my_card_status, entry_sector_data);
     if (filesize_write_status != SDHC_SUCCESS)
     {
         // Fatal error
         __BKPT();
     }
-    return E_SUCCESS;
+    return status;
 }
 
+/**
+ * Reads start at the stream's position_fgetc and carry on across sector and
+ * cluster boundaries until buflen bytes have been read or the file ends.
+ * Returns: E_SUCCESS, or E_EOF if the position was already at the end
+ */
 int file_getbuf(file_descriptor descr, char *bufp, int buflen, int *charsreadp) {
     struct sdhc_card_status my_card_status;
+    Stream *stream = stream_get(currentPCB, descr);
+    *charsreadp = 0;
     // Get the file entry sector and number
     uint32_t file_entry_sector;
     int file_entry_number;
-    int get_entry_status = dir_find_file_x(&(currentPCB->streams)[descr].pathname[1], &file_entry_sector, &file_entry_number);
+    int get_entry_status = dir_find_file_x(&stream->pathname[1], &file_entry_sector, &file_entry_number);
     if (get_entry_status != E_SUCCESS)
     {
         return get_entry_status;
@@ -906,82 +945,48 @@ int file_getbuf(file_descriptor descr, char *bufp, int buflen, int *charsreadp)
         __BKPT();
     }
     struct dir_entry_8_3 *dir_entry = ((struct dir_entry_8_3 *)entry_sector_data) + file_entry_number;
-    // Get the current cluster based on (currentPCB->streams)[*descr].position_fgetc
     uint32_t first_data_cluster = dir_entry->DIR_FstClusHI << 16 | dir_entry->DIR_FstClusLO;
-    uint32_t current_cluster_number = first_data_cluster;
-    // In my OS data is always appended to the end of a file
-    // Get the number of clusters in use via the file size
-    uint32_t pos_num_clusters = (currentPCB->streams)[descr].position_fgetc / (bytes_per_sector * sectors_per_cluster);
-    if (pos_num_clusters > 0)
+    uint32_t size = dir_entry->DIR_FileSize;
+    if (stream->position_fgetc >= size || first_data_cluster == 0)
     {
-        uint32_t current_cluster_fat_entry = read_FAT_entry(rca, first_data_cluster);
-        // Traverse the FAT to take us to the last cluster for this file
-        for (int i = 0; i < pos_num_clusters; i++)
-        {
-            uint32_t current_cluster_fat_entry = read_FAT_entry(rca, current_cluster_fat_entry);
-        }
-        current_cluster_number = current_cluster_fat_entry;
+        return E_EOF;
     }
-    uint8_t position_sector_data[512];
-    // Get the number of bytes from the current position until the end of the file
-    uint32_t remaining_bytes = dir_entry->DIR_FileSize - (currentPCB->streams)[descr].position_fgetc;
-    if (remaining_bytes / bytes_per_sector > 0)
+    uint32_t bytes_per_cluster = bytes_per_sector * sectors_per_cluster;
+    uint32_t cluster;
+    if (cluster_at(first_data_cluster, stream->position_fgetc, &cluster) != E_SUCCESS)
     {
-        remaining_bytes = remaining_bytes % bytes_per_sector;
+        // The chain is shorter than the size says
+        return E_EOF;
     }
-    // Read the current sector data and send as many bytes possible to caller
-    int data_read_status = sdhc_read_single_block(rca, (currentPCB->streams)[descr].position_sector, &my_card_status, position_sector_data);
-    if (data_read_status != SDHC_SUCCESS)
+    uint8_t position_sector_data[512];
+    int n = 0;
+    while (n < buflen && stream->position_fgetc < size)
     {
-        // Fatal error
-        __BKPT();
-    }
-    // Check if the number of bytes requested spills over into the next sector
-    int32_t num_spillover_bytes = buflen - remaining_bytes;
-    if (num_spillover_bytes <= 0) {
-        num_spillover_bytes = 0;
-    }
-    // Send as many bytes as you can without spilling over or exceeding requested amount
-    strncpy(bufp, (char *)&(position_sector_data[(currentPCB->streams)[descr].position_fgetc]), buflen-num_spillover_bytes);
-    *charsreadp = buflen-num_spillover_bytes;
-    (currentPCB->streams)[descr].position_fgetc += buflen-num_spillover_bytes;
-    if (num_spillover_bytes > 0) {
-        // Check if the current sector is the last in the cluster
-        // Get the number of bytes in-use in the last in-use cluster
-        uint32_t bytes_after_cluster_div = dir_entry->DIR_FileSize % (bytes_per_sector * sectors_per_cluster);
-        // Get the sector cluster index to see if we're in the last sector and need to check the FAT
-        uint32_t sector_cluster_index = bytes_after_cluster_div / bytes_per_sector;
-        if (sector_cluster_index == sectors_per_cluster - 1)
+        uint32_t offset = stream->position_fgetc;
+        if (n > 0 && offset % bytes_per_cluster == 0 && cluster_next(cluster, &cluster) != E_SUCCESS)
         {
-            // This is the last sector in the cluster. 
-            // Check if there is data in the next cluster
-            uint32_t current_cluster_FAT_entry = read_FAT_entry(rca, current_cluster_number);
-            if (current_cluster_FAT_entry >= FAT_ENTRY_ALLOCATED_AND_END_OF_FILE)
-            {
-                // The next cluster isn't in use, return E_EOF
-                return E_EOF;
-            }
-            else if (current_cluster_FAT_entry == FAT_ENTRY_DEFECTIVE_CLUSTER)
-            {
-                // Fatal error
-                __BKPT();
-            }
-            // FAT entry is in use and points to next cluster
-            // Read the first sector, and send the spillover bytes to the caller
-            current_cluster_number = current_cluster_FAT_entry;
-            uint32_t position_sector_number = first_sector_of_cluster(current_cluster_number);
-            // Read the current sector data
-            int data_read_status = sdhc_read_single_block(rca, position_sector_number, &my_card_status, position_sector_data);
-            if (data_read_status != SDHC_SUCCESS)
-            {
-                // Fatal error
-                __BKPT();
-            }
-            // Send the bytes to the callers buffer
-            strncpy(bufp, (char *)&position_sector_data, num_spillover_bytes);
-            *charsreadp = *charsreadp + num_spillover_bytes;
-            (currentPCB->streams)[descr].position_fgetc += num_spillover_bytes;
+            break;
+        }
+        uint32_t in_sector = offset % bytes_per_sector;
+        uint32_t chunk = bytes_per_sector - in_sector;
+        if (chunk > buflen - n)
+        {
+            chunk = buflen - n;
+        }
+        if (chunk > size - offset)
+        {
+            chunk = size - offset;
+        }
+        int data_read_status = sdhc_read_single_block(rca, sector_at(cluster, offset), &my_card_status, position_sector_data);
+        if (data_read_status != SDHC_SUCCESS)
+        {
+            // Fatal error
+            __BKPT();
         }
+        memcpy(&bufp[n], &position_sector_data[in_sector], chunk);
+        n += chunk;
+        stream->position_fgetc += chunk;
     }
+    *charsreadp = n;
     return E_SUCCESS;
 }
@@ -0,0 +1,315 @@
+/**
+ * aio.c
+ * Asynchronous file I/O run by a kernel worker process
+ *
+ * Author: James Nicholson
+ */
+
+#include "aio.h"
+#include <stddef.h>
+#include "proc.h"
+#include "waitq.h"
+#include "utils.h"
+#include "devinutils.h"
+#include "myFAT32driver.h"
+
+/**
+ * Implementation Notes
+ *
+ * Synchronous file SVCs run in the SVC handler, where nothing can block, so
+ * they busy-wait for the card. The worker instead runs requests in thread
+ * mode, where sdhc_command sleeps on the SDHC wait queue, so the process
+ * that queued the request and everyone else keep running while the card
+ * programs a block.
+ *
+ * The FAT32 code finds streams through currentPCB, so the worker copies the
+ * requester's stream into its own table for the length of the request and
+ * copies it back afterwards, carrying the updated file position with it.
+ *
+ * The file system code is not reentrant, so while the worker is in the
+ * middle of a request any SVC that uses it sleeps on fs_wq and is restarted
+ * when the worker finishes. SVCs otherwise never preempt each other, so no
+ * other locking is needed.
+ *
+ * Closing an fd cancels the requests still queued on it, and a process that
+ * exits gives up all of its slots, so the worker never runs a request on a
+ * stream that has been closed or reused. A request the worker is running
+ * when its owner exits is freed by the worker when it finishes; it can't be
+ * running when its fd is closed, because myfclose waits on fs_wq.
+ *
+ * A request id is the request's slot index plus a generation count in the
+ * upper bits, so an id that has already been collected is not mistaken for
+ * a later request that reuses the slot.
+ */
+
+enum aio_state
+{
+    AIO_FREE,
+    AIO_QUEUED,
+    AIO_RUNNING,
+    AIO_DONE
+};
+
+struct aio_request
+{
+    enum aio_state state;
+    uint32_t id;
+    enum aio_op op;
+    struct pcb *owner;
+    file_descriptor fd;
+    char *buf;
+    int len;
+    int status;
+    int result;
+    struct aio_request *next;
+};
+
+static struct aio_request requests[AIO_MAX_REQUESTS];
+static uint32_t generation = 0;
+static struct aio_request *queue_head = NULL;
+static struct aio_request *queue_tail = NULL;
+static struct pcb *worker = NULL;
+static volatile int fs_busy = 0;
+
+static struct wait_queue work_wq = WAIT_QUEUE_INIT;
+static struct wait_queue done_wq = WAIT_QUEUE_INIT;
+static struct wait_queue fs_wq = WAIT_QUEUE_INIT;
+
+/**
+ * Run req on the current process's streams.
+ */
+static void run_request(struct aio_request *req)
+{
+    req->result = 0;
+    if (req->op == AIO_OP_READ)
+    {
+        req->status = myfgetc(req->fd, req->buf, req->len, &req->result);
+    }
+    else
+    {
+        req->status = myfputc(&req->fd, req->buf, req->len);
+    }
+}
+
+/**
+ * Take req off the queue. Called with interrupts masked.
+ */
+static void unqueue(struct aio_request *req)
+{
+    struct aio_request **link = &queue_head;
+    struct aio_request *prev = NULL;
+    while (*link != req)
+    {
+        prev = *link;
+        link = &prev->next;
+    }
+    *link = req->next;
+    if (queue_tail == req)
+    {
+        queue_tail = prev;
+    }
+}
+
+static struct aio_request *take_request(void)
+{
+    struct aio_request *req = queue_head;
+    if (req != NULL)
+    {
+        queue_head = req->next;
+        if (queue_head == NULL)
+        {
+            queue_tail = NULL;
+        }
+        req->state = AIO_RUNNING;
+        fs_busy = 1;
+    }
+    return req;
+}
+
+static int aio_worker(int argc, char **argv)
+{
+    while (1)
+    {
+        struct aio_request *req;
+        WAIT_EVENT(&work_wq, (req = take_request()) != NULL);
+        if (req->owner->state == PROC_EXITED || !stream_get(req->owner, req->fd)->in_use)
+        {
+            req->status = E_FILE_CLOSED;
+            req->result = 0;
+        }
+        else if (streams_reserve(worker, req->fd) == E_SUCCESS)
+        {
+            Stream *mine = stream_get(worker, req->fd);
+            Stream *theirs = stream_get(req->owner, req->fd);
+            Stream saved = *mine;
+            *mine = *theirs;
+            run_request(req);
+            *theirs = *mine;
+            *mine = saved;
+        }
+        else
+        {
+            req->status = E_MALLOC;
+        }
+        uint32_t primask = proc_irq_save();
+        // Nobody is left to collect the request of a process that has exited
+        req->state = req->owner->state == PROC_EXITED ? AIO_FREE : AIO_DONE;
+        fs_busy = 0;
+        proc_irq_restore(primask);
+        waitq_wake_all(&fs_wq);
+        waitq_wake_all(&done_wq);
+    }
+    return 0;
+}
+
+int aio_init(void)
+{
+    return proc_create(aio_worker, 0, NULL, &worker);
+}
+
+/**
+ * Returns: the current process's request with the given id, or NULL
+ */
+static struct aio_request *find_request(uint32_t id)
+{
+    struct aio_request *req = &requests[id & (AIO_MAX_REQUESTS - 1)];
+    if (req->state == AIO_FREE || req->id != id || req->owner != currentPCB)
+    {
+        return NULL;
+    }
+    return req;
+}
+
+int aio_submit(enum aio_op op, file_descriptor fd, char *buf, int len, uint32_t *idp)
+{
+    Stream *stream = stream_get(currentPCB, fd);
+    if (stream == NULL || !stream->in_use)
+    {
+        return E_FILE_CLOSED;
+    }
+    // Other devices may wait for input that never comes, and would hold up
+    // every file system SVC behind fs_busy while they did.
+    if (stream->device != &FAT32)
+    {
+        return E_NOT_SUPPORTED;
+    }
+    struct aio_request *req = NULL;
+    for (int i = 0; i < AIO_MAX_REQUESTS; i++)
+    {
+        if (requests[i].state == AIO_FREE)
+        {
+            req = &requests[i];
+            break;
+        }
+    }
+    if (req == NULL)
+    {
+        return E_AIO_FULL;
+    }
+    req->id = (++generation * AIO_MAX_REQUESTS) | (req - requests);
+    req->op = op;
+    req->owner = currentPCB;
+    req->fd = fd;
+    req->buf = buf;
+    req->len = len;
+    req->next = NULL;
+    *idp = req->id;
+    if (worker == NULL || !proc_started())
+    {
+        run_request(req);
+        req->state = AIO_DONE;
+        return E_SUCCESS;
+    }
+    uint32_t primask = proc_irq_save();
+    req->state = AIO_QUEUED;
+    if (queue_tail == NULL)
+    {
+        queue_head = req;
+    }
+    else
+    {
+        queue_tail->next = req;
+    }
+    queue_tail = req;
+    proc_irq_restore(primask);
+    waitq_wake_all(&work_wq);
+    return E_SUCCESS;
+}
+
+void aio_cancel(file_descriptor fd)
+{
+    uint32_t primask = proc_irq_save();
+    for (int i = 0; i < AIO_MAX_REQUESTS; i++)
+    {
+        struct aio_request *req = &requests[i];
+        if (req->state == AIO_QUEUED && req->owner == currentPCB && req->fd == fd)
+        {
+            unqueue(req);
+            req->status = E_FILE_CLOSED;
+            req->result = 0;
+            req->state = AIO_DONE;
+        }
+    }
+    proc_irq_restore(primask);
+    waitq_wake_all(&done_wq);
+}
+
+void aio_exit(void)
+{
+    uint32_t primask = proc_irq_save();
+    for (int i = 0; i < AIO_MAX_REQUESTS; i++)
+    {
+        struct aio_request *req = &requests[i];
+        if (req->owner != currentPCB)
+        {
+            continue;
+        }
+        if (req->state == AIO_QUEUED)
+        {
+            unqueue(req);
+            req->state = AIO_FREE;
+        }
+        else if (req->state == AIO_DONE)
+        {
+            req->state = AIO_FREE;
+        }
+    }
+    proc_irq_restore(primask);
+}
+
+int aio_status(uint32_t id, int *resultp)
+{
+    struct aio_request *req = find_request(id);
+    if (req == NULL)
+    {
+        return E_AIO_ID;
+    }
+    if (req->state != AIO_DONE)
+    {
+        return E_AIO_PENDING;
+    }
+    *resultp = req->result;
+    req->state = AIO_FREE;
+    return req->status;
+}
+
+int aio_wait(uint32_t id)
+{
+    struct aio_request *req = find_request(id);
+    if (req == NULL || req->state == AIO_DONE || !proc_started())
+    {
+        return 0;
+    }
+    waitq_block(&done_wq);
+    return 1;
+}
+
+int aio_fs_wait(void)
+{
+    if (!fs_busy)
+    {
+        return 0;
+    }
+    waitq_block(&fs_wq);
+    return 1;
+}
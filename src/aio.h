@@ -0,0 +1,78 @@
+/**
+ * aio.h
+ * Asynchronous file I/O run by a kernel worker process
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _AIO_H
+#define _AIO_H
+
+#include <stdint.h>
+#include "devinio.h"
+
+/**
+ * Number of requests that can be queued or awaiting collection at once,
+ * across all processes. Must be a power of two.
+ */
+#define AIO_MAX_REQUESTS 16
+
+enum aio_op
+{
+    AIO_OP_READ,
+    AIO_OP_WRITE
+};
+
+/**
+ * Create the worker process. Call after proc_init and before proc_start.
+ * Returns: E_SUCCESS, or E_MALLOC if there is no memory for the worker
+ */
+int aio_init(void);
+
+/**
+ * Queue a read (into buf, up to len bytes) or write (of buf, with len as
+ * for myfputc) on the current process's fd, which must be a FAT32 file,
+ * and store its request id in *idp. Neither fd nor buf may be used in any
+ * other way, and buf must stay allocated, until the request completes.
+ * Before the scheduler starts the request runs to completion immediately.
+ * Returns: E_SUCCESS, E_FILE_CLOSED, E_NOT_SUPPORTED if fd is not a FAT32
+ * file, or E_AIO_FULL if no request is free
+ */
+int aio_submit(enum aio_op op, file_descriptor fd, char *buf, int len, uint32_t *idp);
+
+/**
+ * Called by myfclose before fd is closed. The current process's requests
+ * still queued on fd are not run; they complete with E_FILE_CLOSED.
+ */
+void aio_cancel(file_descriptor fd);
+
+/**
+ * Called when the current process exits. Its queued requests are not run,
+ * and its slots are freed, or freed by the worker once the request it is
+ * running finishes.
+ */
+void aio_exit(void);
+
+/**
+ * Collect request id. Once it has completed, its status is returned, the
+ * number of bytes read is stored in *resultp and the id is released.
+ * Returns: E_AIO_PENDING if it has not completed, or E_AIO_ID if id is not
+ * a request of the current process
+ */
+int aio_status(uint32_t id, int *resultp);
+
+/**
+ * Called from the SVC handler on behalf of a process that wants to block
+ * until request id completes. Returns: 1 if the process has been put to
+ * sleep and must retry, 0 if it should call aio_status now
+ */
+int aio_wait(uint32_t id);
+
+/**
+ * Called from the SVC handler before any SVC that uses the file system.
+ * Returns: 1 if the worker is part way through a request, in which case the
+ * calling process has been put to sleep and must retry, 0 otherwise
+ */
+int aio_fs_wait(void);
+
+#endif /* ifndef _AIO_H */
@@ -0,0 +1,49 @@
+/**
+ * arena.c
+ * Bump allocated scratch memory
+ *
+ * Author: James Nicholson
+ */
+
+#include "arena.h"
+#include "my-malloc.h"
+#include "utils.h"
+#include <stddef.h>
+
+#define ARENA_ALIGN 8
+
+struct arena *arena_create(uint32_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    struct arena *arena = myMalloc(sizeof(struct arena) + size);
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    arena->base = arena->data;
+    arena->size = size;
+    arena->used = 0;
+    return arena;
+}
+
+void *arena_alloc(struct arena *arena, uint32_t size)
+{
+    uint32_t rounded = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (rounded > arena->size - arena->used)
+    {
+        return NULL;
+    }
+    void *p = arena->base + arena->used;
+    arena->used += rounded;
+    return p;
+}
+
+void arena_reset(struct arena *arena)
+{
+    arena->used = 0;
+}
+
+int arena_destroy(struct arena *arena)
+{
+    return myFree(arena);
+}
@@ -0,0 +1,48 @@
+/**
+ * arena.h
+ * Bump allocated scratch memory
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stdint.h>
+
+/**
+ * An arena is a single block of SDRAM handed out by bumping an offset.
+ * Individual allocations are never freed; arena_reset releases all of them
+ * at once.
+ */
+struct arena
+{
+    uint8_t *base;  // first byte available for allocation
+    uint32_t size;  // number of bytes available for allocation
+    uint32_t used;  // offset of the next allocation from base
+    uint8_t data[0];
+};
+
+/**
+ * Allocate an arena that can hold size bytes of allocations.
+ * Returns: a pointer to the arena, or NULL if the heap could not satisfy it
+ */
+struct arena *arena_create(uint32_t size);
+
+/**
+ * Allocate size bytes from the arena, aligned to a double word boundary.
+ * Returns: a pointer to the memory, or NULL if the arena is exhausted
+ */
+void *arena_alloc(struct arena *arena, uint32_t size);
+
+/**
+ * Release every allocation made from the arena since it was created or last reset.
+ */
+void arena_reset(struct arena *arena);
+
+/**
+ * Return the arena's memory to the heap.
+ */
+int arena_destroy(struct arena *arena);
+
+#endif /* ifndef _ARENA_H */
@@ -0,0 +1,37 @@
+/**
+ * clock.c
+ * Monotonic high resolution clock
+ *
+ * Author: James Nicholson
+ */
+
+#include "clock.h"
+#include "dwt.h"
+
+static uint64_t cycle_base = 0;
+static uint32_t last_cycles = 0;
+
+uint64_t clock_cycles(void)
+{
+    uint32_t primask = proc_irq_save();
+    uint32_t now = dwt_cycles();
+    // Unsigned subtraction is correct across a single wrap of the counter
+    cycle_base += (uint32_t)(now - last_cycles);
+    last_cycles = now;
+    uint64_t cycles = cycle_base;
+    proc_irq_restore(primask);
+    return cycles;
+}
+
+uint64_t clock_us(void)
+{
+    return clock_cycles() / CLOCK_CYCLES_PER_US;
+}
+
+void clock_delay_us(uint32_t us)
+{
+    uint64_t end = clock_cycles() + (uint64_t)us * CLOCK_CYCLES_PER_US;
+    while (clock_cycles() < end)
+    {
+    }
+}
@@ -0,0 +1,34 @@
+/**
+ * clock.h
+ * Monotonic high resolution clock
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include <stdint.h>
+#include "proc.h"
+
+#define CLOCK_CYCLES_PER_US (PROC_CORE_CLOCK_HZ / 1000000)
+
+/**
+ * Returns: core cycles since dwt_init. The 32-bit DWT counter is extended
+ * to 64 bits, which needs this to be called at least once per wrap (35.8
+ * seconds); sysTickHandler does so every tick.
+ */
+uint64_t clock_cycles(void);
+
+/**
+ * Returns: microseconds since dwt_init
+ */
+uint64_t clock_us(void);
+
+/**
+ * Busy-wait for at least us microseconds. For use where the caller cannot
+ * sleep; otherwise use proc_sleep.
+ */
+void clock_delay_us(uint32_t us);
+
+#endif /* ifndef _CLOCK_H */
@@ -10,11 +10,16 @@
 #include "utils.h"
 #include "pcb.h"
 #include "devinutils.h"
+#include "aio.h"
 #include <string.h>
 
 
 int myfopen(char *pathname, file_descriptor *fd)
 {
+    if (strlen(pathname) >= sizeof(((Stream *)0)->pathname))
+    {
+        return E_FILE_NAME_TOO_LONG;
+    }
     Device *device;
     int get_device_status = get_device(pathname, &device);
     if (get_device_status == E_DEVICE_PATH) {
@@ -26,11 +31,12 @@ int myfopen(char *pathname, file_descriptor *fd)
     }
     // stream was successfully defined and is located at index *fd
     // finish defining the stream members
-    (currentPCB->streams)[*fd].device = device;
+    Stream *stream = stream_get(currentPCB, *fd);
+    stream->device = device;
     // Copy the pathname into the stream
-    strncpy((&(currentPCB->streams)[*fd])->pathname, pathname, strlen(pathname)+1);
+    strncpy(stream->pathname, pathname, strlen(pathname)+1);
     // Stream is in use
-    (currentPCB->streams)[*fd].in_use = 1;
+    stream_set_open(currentPCB, *fd, 1);
     return E_SUCCESS;
 }
 
@@ -66,28 +72,42 @@ int myfcreate(char *pathname)
     return E_SUCCESS;
 }
 
+// Returns the current process's stream for fd if it is open, otherwise NULL
+static Stream *open_stream(file_descriptor fd)
+{
+    Stream *stream = stream_get(currentPCB, fd);
+    if (stream == NULL || stream->in_use == 0)
+    {
+        return NULL;
+    }
+    return stream;
+}
+
 int myfclose(file_descriptor *fd)
 {
-    if ((currentPCB->streams)[*fd].in_use == 0) {
+    Stream *stream = open_stream(*fd);
+    if (stream == NULL) {
         return E_FILE_CLOSED;
     }
-    Device *device = (currentPCB->streams)[*fd].device;
+    aio_cancel(*fd);
+    Device *device = stream->device;
     int fclose_status = device->fclose(fd);
     if (fclose_status != E_SUCCESS)
     {
         return fclose_status;
     }
-    (currentPCB->streams)[*fd].in_use = 0;
+    stream_set_open(currentPCB, *fd, 0);
     return E_SUCCESS;
 }
 
 int myfputc(file_descriptor *fd, char *bufp, int buflen)
 {
-    if ((currentPCB->streams)[*fd].in_use == 0)
+    Stream *stream = open_stream(*fd);
+    if (stream == NULL)
     {
         return E_FILE_CLOSED;
     }
-    Device *device = (currentPCB->streams)[*fd].device;
+    Device *device = stream->device;
     int fputc_status = device->fputc(fd, bufp, buflen);
     if (fputc_status != E_SUCCESS)
     {
@@ -96,13 +116,30 @@ int myfputc(file_descriptor *fd, char *bufp, int buflen)
     return E_SUCCESS;
 }
 
+int myfflush(file_descriptor *fd)
+{
+    Stream *stream = open_stream(*fd);
+    if (stream == NULL)
+    {
+        return E_FILE_CLOSED;
+    }
+    Device *device = stream->device;
+    // Devices that don't buffer output have nothing to flush
+    if (device->fflush == NULL)
+    {
+        return E_SUCCESS;
+    }
+    return device->fflush(fd);
+}
+
 int myfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
 {
-    if ((currentPCB->streams)[fd].in_use == 0)
+    Stream *stream = open_stream(fd);
+    if (stream == NULL)
     {
         return E_FILE_CLOSED;
     }
-    Device *device = (currentPCB->streams)[fd].device;
+    Device *device = stream->device;
     int fgetc_status = device->fgetc(fd, bufp, buflen, charsreadp);
     if (fgetc_status != E_SUCCESS)
     {
@@ -110,3 +147,25 @@ int myfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
     }
     return E_SUCCESS;
 }
+
+int mypoll(struct poll_fd *fds, int nfds, int *nreadyp)
+{
+    int nready = 0;
+    for (int i = 0; i < nfds; i++)
+    {
+        Stream *stream = open_stream(fds[i].fd);
+        if (stream == NULL)
+        {
+            return E_FILE_CLOSED;
+        }
+        Device *device = stream->device;
+        int ready = device->fready == NULL ? POLL_IN | POLL_OUT : device->fready(fds[i].fd);
+        fds[i].revents = ready & fds[i].events;
+        if (fds[i].revents != 0)
+        {
+            nready++;
+        }
+    }
+    *nreadyp = nready;
+    return E_SUCCESS;
+}
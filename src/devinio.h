@@ -19,6 +19,13 @@
  */
 typedef uint32_t file_descriptor;
 
+/**
+ * Readiness bits returned by a device's fready and used by mypoll. POLL_IN
+ * means fgetc would not wait and POLL_OUT that fputc would not.
+ */
+#define POLL_IN 0x1
+#define POLL_OUT 0x2
+
 typedef struct device
 {
     int (*fgetc)(file_descriptor descr, char *bufp, int buflen, int *charsreadp);
@@ -27,18 +34,26 @@ typedef struct device
     int (*fdelete)(char *pathname);
     int (*fclose)(file_descriptor *fd);
     int (*fcreate)(char *pathname);
+    int (*fflush)(file_descriptor *fd); // may be NULL if the device does not buffer output
+    int (*fready)(file_descriptor fd); // POLL_ bits; may be NULL if the device never makes the caller wait
 } Device;
 
 typedef struct stream
 {
     Device *device; // pointer to the Device used to operate on the file
-    char device_id[]; // a string used to uniquely id the device from other devices of the same type
+    char device_id[4]; // a string used to uniquely id the device from other devices of the same type
     uint8_t in_use; // whether the stream is currently in use (stream.in_use=1) or not (stream.in_use=0)
-    char pathname[12]; // the pathname of the file
+    char pathname[20]; // the pathname of the file
     // FAT32 members
     uint32_t position_fgetc; // the offset in bytes from the start of the file of the current position (only used by fgetc)
     uint32_t position_sector; // the sector number of the open file's position
     uint32_t position_in_sector; // the offset in bytes within the position_sector
+    // Buffered stream members
+    char *buffer; // the stream's buffer, NULL until it is first needed
+    uint32_t buffer_size; // the size of buffer in bytes
+    uint32_t buffer_used; // the number of bytes of buffer holding data
+    uint32_t buffer_pos; // the number of those bytes already read (only used by input streams)
+    void *dev_data; // the driver's own state for the open file
 } Stream;
 
 int myfclose(file_descriptor *fd);
@@ -53,4 +68,23 @@ int myfputc(file_descriptor *fd, char *bufp, int buflen);
 
 int myfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp);
 
+int myfflush(file_descriptor *fd);
+
+/**
+ * One entry of the set of streams passed to mypoll.
+ */
+struct poll_fd
+{
+    file_descriptor fd;
+    uint16_t events; // POLL_ bits the caller is interested in
+    uint16_t revents; // set by mypoll to those of events that are ready
+};
+
+/**
+ * Set revents of each of the nfds entries at fds without waiting.
+ * Returns: E_SUCCESS with the number of entries with revents set in
+ * *nreadyp, or E_FILE_CLOSED if any fd is not open
+ */
+int mypoll(struct poll_fd *fds, int nfds, int *nreadyp);
+
 #endif /* ifndef _DEVINIO_H */
@@ -13,6 +13,10 @@
 #include "myFAT32driver.h"
 #include "myLEDdriver.h"
 #include "myPBdriver.h"
+#include "myPIPEdriver.h"
+#include "myMQdriver.h"
+#include "myTMPdriver.h"
+#include "myNULLdriver.h"
 #include "mySDHCdriver.h"
 #include "utils.h"
 #include <string.h>
@@ -44,6 +48,35 @@ int initDevices(void)
     {
         return initPB_status;
     }
+    /**
+     * Init pipes and message queues
+     */
+    int initPIPE_status = initPIPE();
+    if (initPIPE_status != E_SUCCESS)
+    {
+        return initPIPE_status;
+    }
+    int initMQ_status = initMQ();
+    if (initMQ_status != E_SUCCESS)
+    {
+        return initMQ_status;
+    }
+    /**
+     * Init /dev/null and /dev/zero
+     */
+    int initNULL_status = initNULL();
+    if (initNULL_status != E_SUCCESS)
+    {
+        return initNULL_status;
+    }
+    /**
+     * Init the /tmp RAM disk
+     */
+    int initTMP_status = initTMP(TMP_DEFAULT_BLOCKS);
+    if (initTMP_status != E_SUCCESS)
+    {
+        return initTMP_status;
+    }
     /**
      * Init the FAT32 file system
      */
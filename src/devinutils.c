@@ -6,83 +6,210 @@
  */
 
 #include "devinutils.h"
-#include "devinit.h"
 #include "pcb.h"
 #include "utils.h"
-#include "myLEDdriver.h"
-#include "myFAT32driver.h"
-#include "myPBdriver.h"
+#include "my-malloc.h"
 #include <string.h>
 
-int get_device(char *pathname, Device **device)
+/**
+ * Implementation Notes
+ *
+ * Registered paths live in an open addressing hash table keyed by the
+ * 32-bit FNV-1a hash of the path. FNV-1a is computed a byte at a time, so
+ * the hash of every leading part of a pathname is available along the way:
+ * get_device makes one pass over the pathname, probing for a prefix entry
+ * at each length some prefix was registered with, and probes for an exact
+ * entry at the end. The longest match wins, and an exact match beats any
+ * prefix, so "/" can catch every path no driver claims.
+ */
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+struct dev_entry
 {
-    char sw1_path[] = "/dev/sw1";
-    char sw2_path[] = "/dev/sw2";
-    char ledy_path[] = "/dev/ledy";
-    char ledg_path[] = "/dev/ledg";
-    char ledb_path[] = "/dev/ledb";
-    char ledo_path[] = "/dev/ledo";
-    char uart_path[] = "/dev/uart";
-    // Check if the pathname matches one of the pre-initialized devices
-    if (strcmp(pathname, &sw1_path[0]) == 0)
+    uint32_t hash;
+    const char *path;
+    uint32_t len;
+    int match; // DEV_EXACT or DEV_PREFIX
+    Device *device; // NULL if the entry is unused
+};
+
+static struct dev_entry registry[DEV_REGISTRY_SIZE];
+static int registry_used = 0;
+
+// Bit n is set if a prefix of length n has been registered.
+static uint32_t prefix_lengths = 0;
+
+static uint32_t fnv1a_step(uint32_t hash, char c)
+{
+    return (hash ^ (uint8_t)c) * FNV_PRIME;
+}
+
+static struct dev_entry *dev_lookup(uint32_t hash, const char *path, uint32_t len, int match)
+{
+    for (uint32_t i = hash;; i++)
     {
-        *device = &SW1;
-        return E_SUCCESS;
+        struct dev_entry *entry = &registry[i & (DEV_REGISTRY_SIZE - 1)];
+        if (entry->device == NULL)
+        {
+            return NULL;
+        }
+        if (entry->hash == hash && entry->len == len && entry->match == match &&
+            memcmp(entry->path, path, len) == 0)
+        {
+            return entry;
+        }
     }
-    if (strcmp(pathname, &sw2_path[0]) == 0)
+}
+
+int dev_register(const char *path, Device *device, int match)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    uint32_t len = 0;
+    while (path[len] != '\0')
     {
-        *device = &SW2;
-        return E_SUCCESS;
+        hash = fnv1a_step(hash, path[len++]);
     }
-    if (strcmp(pathname, &ledy_path[0]) == 0)
+    if (match == DEV_PREFIX && (len == 0 || len >= 32))
     {
-        *device = &LEDYellow;
-        return E_SUCCESS;
+        return E_DEVICE_PATH;
     }
-    if (strcmp(pathname, &ledg_path[0]) == 0)
+    struct dev_entry *entry = dev_lookup(hash, path, len, match);
+    if (entry == NULL)
     {
-        *device = &LEDGreen;
-        return E_SUCCESS;
+        // Keep one entry free so that a failed lookup always terminates
+        if (registry_used == DEV_REGISTRY_SIZE - 1)
+        {
+            return E_DEVICE_REGISTRY_FULL;
+        }
+        uint32_t i = hash;
+        while (registry[i & (DEV_REGISTRY_SIZE - 1)].device != NULL)
+        {
+            i++;
+        }
+        entry = &registry[i & (DEV_REGISTRY_SIZE - 1)];
+        registry_used++;
     }
-    if (strcmp(pathname, &ledb_path[0]) == 0)
+    entry->hash = hash;
+    entry->path = path;
+    entry->len = len;
+    entry->match = match;
+    entry->device = device;
+    if (match == DEV_PREFIX)
     {
-        *device = &LEDBlue;
-        return E_SUCCESS;
+        prefix_lengths |= 1u << len;
     }
-    if (strcmp(pathname, &ledo_path[0]) == 0)
+    return E_SUCCESS;
+}
+
+int get_device(char *pathname, Device **device)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    uint32_t len = 0;
+    Device *found = NULL;
+    while (pathname[len] != '\0')
     {
-        *device = &LEDOrange;
-        return E_SUCCESS;
+        hash = fnv1a_step(hash, pathname[len++]);
+        if (len < 32 && (prefix_lengths & (1u << len)))
+        {
+            struct dev_entry *entry = dev_lookup(hash, pathname, len, DEV_PREFIX);
+            if (entry != NULL)
+            {
+                found = entry->device;
+            }
+        }
     }
-    if (strncmp(pathname, &uart_path[0], strlen(const &uart_path[0]) + 1) == 0)
+    struct dev_entry *entry = dev_lookup(hash, pathname, len, DEV_EXACT);
+    if (entry != NULL)
     {
-        *device = &UART;
-        return E_SUCCESS;
+        found = entry->device;
     }
-    // If the first char in pathname is "/" and it's not an exact match with an already
-    // initialized device it is assumed to be referencing a FAT32 file 
-    if (*pathname == '/')
+    if (found == NULL)
     {
-        *device = &FAT32;
-        return E_SUCCESS;
+        return E_DEVICE_PATH;
     }
-    // If no match return an error
-    return E_DEVICE_PATH;
+    *device = found;
+    return E_SUCCESS;
 }
 
-// Get the first available stream in pcb->streams or return an error
-int get_available_stream(file_descriptor *fd)
+void streams_init(struct pcb *pcb)
 {
-    // Check for the first open Stream in pcb->streams
-    for (int i = 0; i < sizeof(currentPCB->streams) / sizeof(currentPCB->streams[0]); i++)
+    for (int t = 0; t < STREAM_TABLES; t++)
     {
-        // Stream is available
-        if ((currentPCB->streams)[i].in_use == 0)
+        pcb->streams_open[t] = 0;
+        pcb->stream_tables[t] = NULL;
+    }
+    pcb->tables_full = 0;
+    pcb->stream_tables[0] = pcb->streams;
+    for (int i = 0; i < STREAMS_PER_TABLE; i++)
+    {
+        pcb->streams[i].in_use = 0;
+    }
+}
+
+int streams_reserve(struct pcb *pcb, file_descriptor fd)
+{
+    if (fd >= MAX_STREAMS)
+    {
+        return E_MAX_STREAMS;
+    }
+    uint32_t t = fd / STREAMS_PER_TABLE;
+    if (pcb->stream_tables[t] == NULL)
+    {
+        Stream *table = myMalloc(sizeof(Stream) * STREAMS_PER_TABLE);
+        if (table == NULL)
+        {
+            return E_MALLOC;
+        }
+        for (int i = 0; i < STREAMS_PER_TABLE; i++)
+        {
+            table[i].in_use = 0;
+        }
+        pcb->stream_tables[t] = table;
+    }
+    return E_SUCCESS;
+}
+
+void stream_set_open(struct pcb *pcb, file_descriptor fd, int open)
+{
+    uint32_t t = fd / STREAMS_PER_TABLE;
+    uint32_t bit = 1u << (fd % STREAMS_PER_TABLE);
+    stream_get(pcb, fd)->in_use = open;
+    if (open)
+    {
+        pcb->streams_open[t] |= bit;
+        if (pcb->streams_open[t] == 0xFFFFFFFF)
         {
-            // Pass the file descriptor back to the caller
-            *fd = i;
-            return E_SUCCESS;
+            pcb->tables_full |= 1u << t;
         }
     }
-    return E_MAX_STREAMS;
+    else
+    {
+        pcb->streams_open[t] &= ~bit;
+        pcb->tables_full &= ~(1u << t);
+    }
+}
+
+/**
+ * Get the lowest numbered free stream of the current process, allocating
+ * a new table if every existing one is full. Two find-first-zero steps on
+ * the open bitmaps, so the cost does not depend on how many are open.
+ */
+int get_available_stream(file_descriptor *fd)
+{
+    uint32_t free_tables = ~currentPCB->tables_full & ((1u << STREAM_TABLES) - 1);
+    if (free_tables == 0)
+    {
+        return E_MAX_STREAMS;
+    }
+    uint32_t t = __builtin_ctz(free_tables);
+    file_descriptor free_fd = t * STREAMS_PER_TABLE + __builtin_ctz(~currentPCB->streams_open[t]);
+    int reserve_status = streams_reserve(currentPCB, free_fd);
+    if (reserve_status != E_SUCCESS)
+    {
+        return reserve_status;
+    }
+    *fd = free_fd;
+    return E_SUCCESS;
 }
@@ -9,16 +9,63 @@
 #define _DEVINUTILS_H
 
 #include "devinio.h"
+#include "pcb.h"
 
-#define NUMBER_OF_DEVICES 7
+/**
+ * Capacity of the device registry. Must be a power of two larger than the
+ * number of registered paths.
+ */
+#define DEV_REGISTRY_SIZE 32
+
+/**
+ * How a registered path is matched: the whole pathname, or any pathname
+ * that starts with it. Prefixes must be shorter than 32 characters.
+ */
+#define DEV_EXACT 0
+#define DEV_PREFIX 1
 
 /**
  * Indicates whether the file system is mounted: 0 if false, 1 if true.
  */
 extern int file_structure_mounted;
 
+/**
+ * Register device to handle path. path must stay valid, so it is normally
+ * a string literal. Registering a path again replaces its device.
+ * Returns: E_SUCCESS, E_DEVICE_PATH if path is not a valid prefix, or
+ * E_DEVICE_REGISTRY_FULL
+ */
+int dev_register(const char *path, Device *device, int match);
+
+/**
+ * Find the device for pathname: an exact registration if there is one,
+ * otherwise the longest registered prefix.
+ * Returns: E_SUCCESS, or E_DEVICE_PATH if no device matches
+ */
 int get_device(char *pathname, Device **device);
 
+/**
+ * Close every stream of a new pcb.
+ */
+void streams_init(struct pcb *pcb);
+
+/**
+ * Make sure pcb has the stream table that fd belongs in.
+ * Returns: E_SUCCESS, E_MAX_STREAMS if fd is too large, or E_MALLOC
+ */
+int streams_reserve(struct pcb *pcb, file_descriptor fd);
+
+/**
+ * Mark fd of pcb open or closed. Its table must exist.
+ */
+void stream_set_open(struct pcb *pcb, file_descriptor fd, int open);
+
+/**
+ * Find the lowest numbered closed stream of the current process and store
+ * its number in *fd. The stream is not marked open.
+ * Returns: E_SUCCESS, E_MAX_STREAMS, or E_MALLOC if a new table is needed
+ * and there is no memory for it
+ */
 int get_available_stream(file_descriptor *fd);
 
 #endif /** ifndef _DEVINUTILS.H **/
\ No newline at end of file
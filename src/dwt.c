@@ -0,0 +1,15 @@
+/**
+ * dwt.c
+ * Cycle counting with the DWT (Data Watchpoint and Trace) unit
+ *
+ * Author: James Nicholson
+ */
+
+#include "dwt.h"
+
+void dwt_init(void)
+{
+    DWT_DEMCR |= DWT_DEMCR_TRCENA_MASK;
+    DWT_CYCLE_COUNT = 0;
+    DWT_CONTROL |= DWT_CONTROL_CYCCNTENA_MASK;
+}
@@ -0,0 +1,36 @@
+/**
+ * dwt.h
+ * Cycle counting with the DWT (Data Watchpoint and Trace) unit
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _DWT_H
+#define _DWT_H
+
+#include <stdint.h>
+
+/* See C1.8 (DWT) and C1.6.5 (DEMCR) of the ARMv7-M Architecture Reference
+ * Manual, ARM DDI 0403D */
+#define DWT_DEMCR (*(volatile uint32_t *)0xE000EDFC)
+#define DWT_DEMCR_TRCENA_MASK (1u << 24)
+#define DWT_CONTROL (*(volatile uint32_t *)0xE0001000)
+#define DWT_CONTROL_CYCCNTENA_MASK (1u << 0)
+#define DWT_CYCLE_COUNT (*(volatile uint32_t *)0xE0001004)
+
+/**
+ * Start the free running core cycle counter.
+ */
+void dwt_init(void);
+
+/**
+ * Returns: the core cycle count. It wraps every 2^32 cycles (about 35.8
+ * seconds at 120 MHz), so only differences of values read less than that
+ * far apart are meaningful.
+ */
+static inline uint32_t dwt_cycles(void)
+{
+    return DWT_CYCLE_COUNT;
+}
+
+#endif /* ifndef _DWT_H */
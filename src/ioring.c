@@ -0,0 +1,211 @@
+/**
+ * ioring.c
+ * Batched file I/O through a shared submission/completion ring
+ *
+ * Author: James Nicholson
+ */
+
+#include "ioring.h"
+#include <stddef.h>
+#include <string.h>
+#include "svc.h"
+#include "utils.h"
+#include "pcb.h"
+#include "myFAT32driver.h"
+
+/**
+ * Implementation Notes
+ *
+ * A process queues any number of operations and then traps once with
+ * SVCMyio_submit, so the SVC entry and exit cost is paid per batch rather
+ * than per operation. The ring is process memory, so every buffer an entry
+ * points at is checked with svc_user_range_valid, or svc_user_input_valid
+ * if it is only written out, and every path with svc_user_string_valid,
+ * just like an SVC argument, and each entry is copied before it is checked.
+ *
+ * An entry that would block, such as a read of an empty pipe, stops the
+ * batch: the process sleeps when the SVC returns and the entry is left at
+ * the head of the submission queue for the next submit.
+ *
+ * Consecutive writes to the same FAT32 file are merged into one call to
+ * file_putbuf. Each file_putbuf reads and rewrites the directory entry and
+ * the position sector whatever its length, so merging n small writes saves
+ * 4(n - 1) card operations. Every merged entry still gets its own
+ * completion, carrying the status of the combined write.
+ */
+
+void io_ring_init(struct io_ring *ring)
+{
+    ring->sq_head = 0;
+    ring->sq_tail = 0;
+    ring->cq_head = 0;
+    ring->cq_tail = 0;
+}
+
+struct io_sqe *io_ring_get_sqe(struct io_ring *ring)
+{
+    if (ring->sq_tail - ring->sq_head == IO_RING_ENTRIES)
+    {
+        return NULL;
+    }
+    return &ring->sq[ring->sq_tail++ & (IO_RING_ENTRIES - 1)];
+}
+
+struct io_cqe *io_ring_peek_cqe(struct io_ring *ring)
+{
+    if (ring->cq_head == ring->cq_tail)
+    {
+        return NULL;
+    }
+    return &ring->cq[ring->cq_head & (IO_RING_ENTRIES - 1)];
+}
+
+void io_ring_cqe_seen(struct io_ring *ring)
+{
+    ring->cq_head++;
+}
+
+static void post_cqe(struct io_ring *ring, uint32_t user_data, int status, int result)
+{
+    struct io_cqe *cqe = &ring->cq[ring->cq_tail & (IO_RING_ENTRIES - 1)];
+    cqe->user_data = user_data;
+    cqe->status = status;
+    cqe->result = result;
+    ring->cq_tail++;
+}
+
+static int run_sqe(struct io_sqe *sqe, int *result)
+{
+    *result = 0;
+    switch (sqe->op)
+    {
+    case IO_OP_NOP:
+        return E_SUCCESS;
+    case IO_OP_OPEN:
+        if (!svc_user_string_valid(sqe->buf))
+        {
+            return E_ADDR_SPC;
+        }
+        {
+            file_descriptor fd;
+            int status = myfopen(sqe->buf, &fd);
+            *result = fd;
+            return status;
+        }
+    case IO_OP_CLOSE:
+        return myfclose(&sqe->fd);
+    case IO_OP_READ:
+        if (!svc_user_range_valid((uint32_t)sqe->buf, sqe->len))
+        {
+            return E_ADDR_SPC;
+        }
+        return myfgetc(sqe->fd, sqe->buf, sqe->len, result);
+    case IO_OP_WRITE:
+        if (!svc_user_input_valid((uint32_t)sqe->buf, sqe->len))
+        {
+            return E_ADDR_SPC;
+        }
+        return myfputc(&sqe->fd, sqe->buf, sqe->len);
+    default:
+        return E_NOT_SUPPORTED;
+    }
+}
+
+/**
+ * Staging buffer for merged writes. SVCs do not preempt each other, so one
+ * buffer serves every process.
+ */
+static char merge_buf[IO_MERGE_MAX];
+
+/**
+ * Returns: 1 if sqe is a write that can follow a write of merged bytes
+ * (excluding the null terminator) to fd in merge_buf
+ */
+static int can_merge(struct io_sqe *sqe, file_descriptor fd, uint32_t merged)
+{
+    return sqe->op == IO_OP_WRITE && sqe->fd == fd && sqe->len > 0 &&
+        merged + sqe->len <= IO_MERGE_MAX &&
+        svc_user_input_valid((uint32_t)sqe->buf, sqe->len);
+}
+
+/**
+ * Try to merge the write at the head of the submission queue with the
+ * writes following it. Returns: the number of entries consumed, or 0 if the
+ * head entry is not worth merging
+ */
+static int submit_merged_write(struct io_ring *ring, uint32_t head, uint32_t tail, uint32_t room)
+{
+    struct io_sqe first = ring->sq[head & (IO_RING_ENTRIES - 1)];
+    Stream *stream = stream_get(currentPCB, first.fd);
+    if (first.op != IO_OP_WRITE || stream == NULL || !stream->in_use || stream->device != &FAT32)
+    {
+        return 0;
+    }
+    uint32_t merged = 0;
+    uint32_t n = 0;
+    while (head + n != tail && n < room)
+    {
+        struct io_sqe sqe = ring->sq[(head + n) & (IO_RING_ENTRIES - 1)];
+        if (!can_merge(&sqe, first.fd, merged))
+        {
+            break;
+        }
+        // FAT32 writes are null terminated and len counts the terminator.
+        // A write stops at an earlier null, so only the bytes before it are
+        // merged; copying it would cut off every write merged after it.
+        uint32_t bytes = strnlen(sqe.buf, sqe.len - 1);
+        memcpy(&merge_buf[merged], sqe.buf, bytes);
+        merged += bytes;
+        n++;
+    }
+    if (n < 2)
+    {
+        return 0;
+    }
+    merge_buf[merged] = '\0';
+    int status = myfputc(&first.fd, merge_buf, merged + 1);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        post_cqe(ring, ring->sq[(head + i) & (IO_RING_ENTRIES - 1)].user_data, status, 0);
+    }
+    return n;
+}
+
+int io_submit(struct io_ring *ring)
+{
+    uint32_t head = ring->sq_head;
+    uint32_t tail = ring->sq_tail;
+    int consumed = 0;
+    if (tail - head > IO_RING_ENTRIES)
+    {
+        // The process has corrupted its own indexes
+        return 0;
+    }
+    while (head != tail)
+    {
+        uint32_t room = IO_RING_ENTRIES - (ring->cq_tail - ring->cq_head);
+        if (room == 0 || room > IO_RING_ENTRIES)
+        {
+            break;
+        }
+        int n = submit_merged_write(ring, head, tail, room);
+        if (n == 0)
+        {
+            struct io_sqe sqe = ring->sq[head & (IO_RING_ENTRIES - 1)];
+            int result;
+            int status = run_sqe(&sqe, &result);
+            if (status == E_BLOCKED)
+            {
+                // The process sleeps once the SVC returns; the entry stays
+                // queued for it to submit again when it wakes.
+                break;
+            }
+            post_cqe(ring, sqe.user_data, status, result);
+            n = 1;
+        }
+        head += n;
+        consumed += n;
+        ring->sq_head = head;
+    }
+    return consumed;
+}
@@ -0,0 +1,101 @@
+/**
+ * ioring.h
+ * Batched file I/O through a shared submission/completion ring
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _IORING_H
+#define _IORING_H
+
+#include <stdint.h>
+#include "devinio.h"
+
+/**
+ * Number of entries in each of the submission and completion queues. Must be
+ * a power of two.
+ */
+#define IO_RING_ENTRIES 32
+
+/**
+ * Largest write, in bytes including the null terminator, that adjacent FAT32
+ * writes are merged into.
+ */
+#define IO_MERGE_MAX 512
+
+enum io_op
+{
+    IO_OP_NOP,
+    IO_OP_OPEN, // open buf as a pathname; result is the new file descriptor
+    IO_OP_CLOSE, // close fd
+    IO_OP_READ, // read up to len bytes from fd into buf; result is the number read
+    IO_OP_WRITE // write buf to fd, with len as for myfputc
+};
+
+/**
+ * Submission queue entry. user_data is copied to the matching completion so
+ * the process can tell its completions apart.
+ */
+struct io_sqe
+{
+    uint32_t op;
+    file_descriptor fd;
+    void *buf;
+    uint32_t len;
+    uint32_t user_data;
+};
+
+/**
+ * Completion queue entry. status is the error_t the operation finished with.
+ */
+struct io_cqe
+{
+    uint32_t user_data;
+    int32_t status;
+    int32_t result;
+};
+
+/**
+ * The ring lives in the process's own memory. The process fills sq entries
+ * and advances sq_tail, the kernel advances sq_head as it consumes them and
+ * cq_tail as it posts completions, and the process advances cq_head as it
+ * reads them. The indexes run freely and are masked with IO_RING_ENTRIES - 1.
+ */
+struct io_ring
+{
+    uint32_t sq_head;
+    uint32_t sq_tail;
+    uint32_t cq_head;
+    uint32_t cq_tail;
+    struct io_sqe sq[IO_RING_ENTRIES];
+    struct io_cqe cq[IO_RING_ENTRIES];
+};
+
+/**
+ * Empty both queues of ring.
+ */
+void io_ring_init(struct io_ring *ring);
+
+/**
+ * Returns: the next free submission entry, or NULL if the submission queue
+ * is full. The entry is queued once it has been filled in, and is submitted
+ * by the next SVCMyio_submit.
+ */
+struct io_sqe *io_ring_get_sqe(struct io_ring *ring);
+
+/**
+ * Returns: the oldest unread completion, or NULL if there are none. Call
+ * io_ring_cqe_seen once it has been read.
+ */
+struct io_cqe *io_ring_peek_cqe(struct io_ring *ring);
+void io_ring_cqe_seen(struct io_ring *ring);
+
+/**
+ * Run the queued submissions of the current process's ring in order, for as
+ * long as there is room for their completions. Called from the SVC handler.
+ * Returns: the number of submissions consumed, 0 if the ring's indexes are
+ * inconsistent
+ */
+int io_submit(struct io_ring *ring);
+
+#endif /* ifndef _IORING_H */
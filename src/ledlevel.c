@@ -0,0 +1,65 @@
+/**
+ * ledlevel.c
+ * Parsing LED brightness levels
+ *
+ * Author: James Nicholson
+ */
+
+#include "ledlevel.h"
+#include "utils.h"
+#include <string.h>
+
+/**
+ * Implementation Notes
+ *
+ * Nothing here touches hardware, so the LED driver's handling of what is
+ * written to it can be tested on its own.
+ */
+
+int led_level_parse(const char *text, int len, uint32_t *percent)
+{
+    int n = strnlen(text, len);
+    if (n > 0 && text[n - 1] == '\n')
+    {
+        n--;
+    }
+    if (n == 2 && strncmp(text, "on", 2) == 0)
+    {
+        *percent = 100;
+        return E_SUCCESS;
+    }
+    if (n == 3 && strncmp(text, "off", 3) == 0)
+    {
+        *percent = 0;
+        return E_SUCCESS;
+    }
+    if (n > 0 && text[n - 1] == '%')
+    {
+        n--;
+    }
+    // At most three digits, so "100" is the longest that can be valid
+    if (n == 0 || n > 3)
+    {
+        return E_LED_LEVEL;
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (text[i] < '0' || text[i] > '9')
+        {
+            return E_LED_LEVEL;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    if (value > 100)
+    {
+        return E_LED_LEVEL;
+    }
+    *percent = value;
+    return E_SUCCESS;
+}
+
+uint32_t led_level_counts(uint32_t percent, uint32_t period)
+{
+    return (percent * period + 50) / 100;
+}
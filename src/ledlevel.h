@@ -0,0 +1,27 @@
+/**
+ * ledlevel.h
+ * Parsing LED brightness levels
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _LEDLEVEL_H
+#define _LEDLEVEL_H
+
+#include <stdint.h>
+
+/**
+ * Parse the first len characters of text (or up to a NUL) as an LED level:
+ * "on", "off", or a percentage from 0 to 100 with or without a trailing
+ * '%', i.e. "25%". A trailing newline is ignored.
+ * Returns: E_SUCCESS with the level in *percent, or E_LED_LEVEL
+ */
+int led_level_parse(const char *text, int len, uint32_t *percent);
+
+/**
+ * Returns: the number of counts out of period that the LED is lit for at
+ * percent, rounded to the nearest count
+ */
+uint32_t led_level_counts(uint32_t percent, uint32_t period);
+
+#endif /* ifndef _LEDLEVEL_H */
@@ -0,0 +1,199 @@
+/**
+ * mem-index.c
+ * Address ordered index of heap regions
+ *
+ * Author: James Nicholson
+ */
+
+#include "mem-index.h"
+#include "utils.h"
+#include <stddef.h>
+
+/**
+ * Implementation Notes
+ *
+ * The index is an AVL tree keyed on the address of each struct mem_region,
+ * so lookups, inserts and removes are all O(log n) in the number of regions.
+ * Nodes come from a fixed pool rather than from myMalloc so that the index
+ * can be updated while myMalloc is in the middle of splitting a region.
+ * Unused nodes are kept on a singly linked free list threaded through
+ * node->right.
+ */
+
+static struct mem_index_node *root = NULL;
+static struct mem_index_node *free_nodes = NULL;
+
+void mem_index_init(void *pool)
+{
+    struct mem_index_node *nodes = (struct mem_index_node *)pool;
+    root = NULL;
+    free_nodes = NULL;
+    for (int i = MEM_INDEX_MAX_NODES - 1; i >= 0; i--)
+    {
+        nodes[i].right = free_nodes;
+        free_nodes = &nodes[i];
+    }
+}
+
+static int height(struct mem_index_node *node)
+{
+    return node == NULL ? 0 : node->height;
+}
+
+static void update_height(struct mem_index_node *node)
+{
+    int lh = height(node->left);
+    int rh = height(node->right);
+    node->height = (lh > rh ? lh : rh) + 1;
+}
+
+static struct mem_index_node *rotate_right(struct mem_index_node *node)
+{
+    struct mem_index_node *pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    update_height(node);
+    update_height(pivot);
+    return pivot;
+}
+
+static struct mem_index_node *rotate_left(struct mem_index_node *node)
+{
+    struct mem_index_node *pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    update_height(node);
+    update_height(pivot);
+    return pivot;
+}
+
+// Restore the AVL property at node after one of its subtrees changed height by one.
+static struct mem_index_node *rebalance(struct mem_index_node *node)
+{
+    update_height(node);
+    int balance = height(node->left) - height(node->right);
+    if (balance > 1)
+    {
+        if (height(node->left->left) < height(node->left->right))
+        {
+            node->left = rotate_left(node->left);
+        }
+        return rotate_right(node);
+    }
+    if (balance < -1)
+    {
+        if (height(node->right->right) < height(node->right->left))
+        {
+            node->right = rotate_right(node->right);
+        }
+        return rotate_left(node);
+    }
+    return node;
+}
+
+static struct mem_index_node *insert_node(struct mem_index_node *node, struct mem_index_node *new_node)
+{
+    if (node == NULL)
+    {
+        return new_node;
+    }
+    if (new_node->region < node->region)
+    {
+        node->left = insert_node(node->left, new_node);
+    }
+    else
+    {
+        node->right = insert_node(node->right, new_node);
+    }
+    return rebalance(node);
+}
+
+int mem_index_insert(struct mem_region *region)
+{
+    if (free_nodes == NULL)
+    {
+        return E_MALLOC;
+    }
+    struct mem_index_node *new_node = free_nodes;
+    free_nodes = free_nodes->right;
+    new_node->region = region;
+    new_node->left = NULL;
+    new_node->right = NULL;
+    new_node->height = 1;
+    root = insert_node(root, new_node);
+    return E_SUCCESS;
+}
+
+// Unlink the smallest node of the subtree into *min and return the new subtree.
+static struct mem_index_node *remove_min(struct mem_index_node *node, struct mem_index_node **min)
+{
+    if (node->left == NULL)
+    {
+        *min = node;
+        return node->right;
+    }
+    node->left = remove_min(node->left, min);
+    return rebalance(node);
+}
+
+static struct mem_index_node *remove_node(struct mem_index_node *node, struct mem_region *region)
+{
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    if (region < node->region)
+    {
+        node->left = remove_node(node->left, region);
+    }
+    else if (region > node->region)
+    {
+        node->right = remove_node(node->right, region);
+    }
+    else
+    {
+        struct mem_index_node *left = node->left;
+        struct mem_index_node *right = node->right;
+        node->right = free_nodes;
+        free_nodes = node;
+        if (right == NULL)
+        {
+            return left;
+        }
+        struct mem_index_node *successor;
+        right = remove_min(right, &successor);
+        successor->left = left;
+        successor->right = right;
+        return rebalance(successor);
+    }
+    return rebalance(node);
+}
+
+void mem_index_remove(struct mem_region *region)
+{
+    root = remove_node(root, region);
+}
+
+struct mem_region *mem_index_floor(const void *addr)
+{
+    struct mem_region *floor = NULL;
+    struct mem_index_node *node = root;
+    while (node != NULL)
+    {
+        if ((const void *)node->region <= addr)
+        {
+            floor = node->region;
+            node = node->right;
+        }
+        else
+        {
+            node = node->left;
+        }
+    }
+    return floor;
+}
+
+struct mem_region *mem_index_prev(struct mem_region *region)
+{
+    return mem_index_floor((const uint8_t *)region - 1);
+}
@@ -0,0 +1,59 @@
+/**
+ * mem-index.h
+ * Address ordered index of heap regions
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _MEMINDEX_H
+#define _MEMINDEX_H
+
+#include <stdint.h>
+#include "my-malloc.h"
+
+/**
+ * Maximum number of regions (free and allocated) the index can hold. The
+ * node pool is carved out of the top of SDRAM by malloc_init.
+ */
+#define MEM_INDEX_MAX_NODES 16384
+
+struct mem_index_node
+{
+    struct mem_region *region;
+    struct mem_index_node *left;
+    struct mem_index_node *right;
+    int height;
+};
+
+#define MEM_INDEX_POOL_SIZE (MEM_INDEX_MAX_NODES * sizeof(struct mem_index_node))
+
+/**
+ * Initialize the index using the memory at pool to hold its nodes.
+ */
+void mem_index_init(void *pool);
+
+/**
+ * Insert region into the index.
+ * Returns: E_SUCCESS, or E_MALLOC if every node in the pool is in use
+ */
+int mem_index_insert(struct mem_region *region);
+
+/**
+ * Remove region from the index. Does nothing if region is not indexed.
+ */
+void mem_index_remove(struct mem_region *region);
+
+/**
+ * Returns the region with the greatest address that is less than or equal
+ * to addr, or NULL if there is none. The region that owns any address in
+ * the heap is mem_index_floor(addr).
+ */
+struct mem_region *mem_index_floor(const void *addr);
+
+/**
+ * Returns the region immediately before region in address order, or NULL
+ * if region is the first one.
+ */
+struct mem_region *mem_index_prev(struct mem_region *region);
+
+#endif /* ifndef _MEMINDEX_H */
@@ -22,6 +22,8 @@
 #include "fsInfo.h"
 #include "FAT.h"
 #include "breakpoint.h"
+#include "nvic.h"
+#include "waitq.h"
 
 uint32_t file_structure_first_sector;
 
@@ -389,16 +391,50 @@ uint32_t sdhc_initialize(void) {
   return rca;
 }
 
+/* Processes waiting for the SDHC to finish a command or data transfer */
+static struct wait_queue sdhc_wait = WAIT_QUEUE_INIT;
+
+/* SDHC interrupt handler: disarm every interrupt source and wake the
+   waiters, who re-check SDHC_IRQSTAT and SDHC_PRSSTAT themselves */
+void sdhcInterruptHandler(void) {
+  SDHC_IRQSIGEN = 0;
+  waitq_wake_all(&sdhc_wait);
+}
+
+/* Returns true when no data transfer is in progress; otherwise arms the
+   transfer complete interrupt.  Called with interrupts masked. */
+static int sdhc_data_lines_idle(void) {
+  if(0 == (SDHC_PRSSTAT & (SDHC_PRSSTAT_RTA_MASK | SDHC_PRSSTAT_DLA_MASK))) {
+    return 1;
+  }
+  SDHC_IRQSTAT = SDHC_IRQSTAT_TC_MASK;
+  SDHC_IRQSIGEN |= SDHC_IRQSIGEN_TCIEN_MASK;
+  /* The transfer may have finished before TC was cleared */
+  return 0 == (SDHC_PRSSTAT & (SDHC_PRSSTAT_RTA_MASK | SDHC_PRSSTAT_DLA_MASK));
+}
+
+/* Returns true once the current command has completed or timed out;
+   otherwise arms the matching interrupts.  Called with interrupts
+   masked. */
+static int sdhc_command_done(void) {
+  if(0 != (SDHC_IRQSTAT & (SDHC_IRQSTAT_CTOE_MASK | SDHC_IRQSTAT_CC_MASK))) {
+    return 1;
+  }
+  SDHC_IRQSIGEN |= SDHC_IRQSIGEN_CTOEIEN_MASK | SDHC_IRQSIGEN_CCIEN_MASK;
+  return 0;
+}
+
 static enum sdhc_status sdhc_command(uint32_t xfertyp, uint32_t cmdarg) {
   /* Clear the command complete flag */
   SDHC_IRQSTAT = SDHC_IRQSTAT_CC_MASK;
 
   SDHC_CMDARG = cmdarg;
 
+  /* Wait for any previous data transfer (e.g., a block being programmed)
+     to finish */
+  WAIT_EVENT(&sdhc_wait, sdhc_data_lines_idle());
+
   uint32_t prsstat;
-  while(((prsstat = SDHC_PRSSTAT) & SDHC_PRSSTAT_RTA_MASK) ||
-	(prsstat & SDHC_PRSSTAT_DLA_MASK)) {
-  }
 
   /* Check the Command Inhibit (CMD) status bit */
   if((prsstat = SDHC_PRSSTAT) & SDHC_PRSSTAT_CIHB_MASK) {
@@ -412,10 +448,8 @@ static enum sdhc_status sdhc_command(uint32_t xfertyp, uint32_t cmdarg) {
 
   SDHC_XFERTYP = xfertyp;
 
-  while(0 == (SDHC_IRQSTAT & SDHC_IRQSTAT_CTOE_MASK) &&
-	0 == (SDHC_IRQSTAT & SDHC_IRQSTAT_CC_MASK)) {
-    /* Wait for command complete */
-  }
+  /* Wait for command complete */
+  WAIT_EVENT(&sdhc_wait, sdhc_command_done());
 
   /* Save and clear IRQ status register */
   uint32_t status = SDHC_IRQSTAT;
@@ -708,6 +742,12 @@ static enum sdhc_status sdhc_init(void) {
   /* Set read and write watermarks to 1 word */
   SDHC_WML = SDHC_WML_RDWML(1) | SDHC_WML_WRWML(1);
 
+  /* Status bits are always latched in SDHC_IRQSTAT; individual bits are
+     only routed to the interrupt (SDHC_IRQSIGEN) while a process is
+     waiting on them */
+  SDHC_IRQSIGEN = 0;
+  nvic_enable_irq(SDHC_IRQ_NUMBER, SDHC_INTERRUPT_PRIORITY);
+
   return sdhc_command_go_idle_state();
 }
 
@@ -809,6 +849,9 @@ static enum sdhc_status sdhc_command_send_status(uint32_t rca, uint32_t *card_st
 				  true, true, rca, card_status);
 }
 
+uint32_t sdhc_blocks_read = 0;
+uint32_t sdhc_blocks_written = 0;
+
 enum sdhc_status sdhc_read_single_block(uint32_t rca, uint32_t block_address,
                                         struct sdhc_card_status *card_status,
                                         uint8_t data[512]) {
@@ -846,6 +889,7 @@ enum sdhc_status sdhc_read_single_block(uint32_t rca, uint32_t block_address,
 	dwords[count++] = SDHC_DATPORT;
       }
     }
+    sdhc_blocks_read++;
   }
   return status;
 }
@@ -885,6 +929,7 @@ enum sdhc_status sdhc_write_single_block(uint32_t rca, uint32_t block_address,
 	SDHC_DATPORT = dwords[count++];
       }
     }
+    sdhc_blocks_written++;
   }
   return status;
 }
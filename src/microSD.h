@@ -24,6 +24,10 @@
 #define MICRO_SD_DEBUG 0
 #define MICRO_SD_INFORMATIVE_PRINTF 0
 
+/* IRQ number (vector number minus 16) and priority of the SDHC interrupt */
+#define SDHC_IRQ_NUMBER 80
+#define SDHC_INTERRUPT_PRIORITY 8
+
 /* Routine to configure the microSD Card Detect switch & pull-down resistor in
    the ARM */
 /* This must be called before calling microSDCardDetectedUsingSwitch
@@ -68,6 +72,9 @@ void microSDCardDisableCardDetectARMPullDownResistor(void);
    header files are appropriately initialized */
 uint32_t sdhc_initialize(void);
 
+/* SDHC interrupt service routine; wakes processes waiting on the card */
+void sdhcInterruptHandler(void);
+
 enum sdhc_status {
   SDHC_SUCCESS,
   SDHC_COMMAND_ERROR_DATA_END_BIT,
@@ -138,6 +145,10 @@ struct sdhc_card_status {
   unsigned int out_of_range: 1;
 };
 
+/* Number of blocks successfully read and written since reset */
+extern uint32_t sdhc_blocks_read;
+extern uint32_t sdhc_blocks_written;
+
 /* Reads a block from the SDHC card */
 /*   rca is the Relative Card Address returned from sdhc_initialize */
 /*   block_address is the number of the sector to be read */
@@ -7,6 +7,11 @@
 #include "utils.h"
 #include "pcb.h"
 #include "sdram.h"
+#include "mem-index.h"
+#include "devinutils.h"
+#include "small-malloc.h"
+#include "proc.h"
+#include "mySTDSTRMdriver.h"
 
 struct pcb *currentPCB;
 
@@ -16,12 +21,16 @@ static void pcb_init(void)
     // Check return for all system call
     currentPCB = malloc(sizeof(struct pcb));
     currentPCB->pid = 0;
+    currentPCB->state = PROC_RUNNING;
+    currentPCB->sp = NULL;
+    currentPCB->stack = NULL;
+    currentPCB->stack_size = 0;
+    currentPCB->ticks = 0;
+    proc_init_timers(currentPCB);
+    currentPCB->next = NULL;
     // initialize streams to not in use
-    // Check for the first open Stream in pcb->streams
-    for (int i = 0; i < sizeof(currentPCB->streams) / sizeof(currentPCB->streams[0]); i++)
-    {
-        (currentPCB->streams)[i].in_use = 0;
-    }
+    streams_init(currentPCB);
+    stdstrm_attach(currentPCB);
 }
 
 /**
@@ -35,6 +44,18 @@ static void pcb_init(void)
 * struct mem_region->size does not include sizeof(struct mem_region).
 * Additionally, mem_region->size is rounded up to the nearest double word boundary.
 * Thus, the location of the next mem_region is: mem_region->data + mem_region->size.
+*
+* Every region, free or allocated, is also recorded in an address ordered
+* index (see mem-index.c) so that finding the region that owns an address is
+* O(log n) instead of a walk from mymem. The index's node pool sits above the
+* heap at the top of SDRAM.
+*
+* Requests of SMALL_MAX_SIZE bytes or less are routed to the size class
+* allocator in small-malloc.c, whose zone sits between the heap and the
+* index pool, and only fall back to the regions below when that zone is full.
+*
+*   SDRAM_START                                                    SDRAM_END
+*   | mymem ... regions ... | small object zone | mem-index node pool |
 **/
 
 static int malloc_initd = 0;
@@ -45,20 +66,156 @@ typedef uint64_t Dword;
 struct mem_region *mymem;
 struct mem_region *endmymem;
 
+struct mem_stats mem_stats;
+
 static int get_pcb(void) {
     return currentPCB->pid;
 }
 
+/**
+ * Statistics helpers
+ * 
+ * Each helper adjusts the counters for a single block entering or leaving
+ * the free or in-use population.
+ */
+static int size_class(uint32_t size)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+    return 31 - __builtin_clz(size);
+}
+
+static int pid_slot(int pid)
+{
+    if (pid < 0 || pid >= MEM_STATS_MAX_PID)
+    {
+        return MEM_STATS_MAX_PID - 1;
+    }
+    return pid;
+}
+
+static void stats_add_free(uint32_t size)
+{
+    mem_stats.bytes_free += size;
+    mem_stats.free_blocks++;
+    mem_stats.free_class[size_class(size)]++;
+}
+
+static void stats_remove_free(uint32_t size)
+{
+    mem_stats.bytes_free -= size;
+    mem_stats.free_blocks--;
+    mem_stats.free_class[size_class(size)]--;
+}
+
+static void stats_add_used(uint32_t size, int pid)
+{
+    mem_stats.bytes_in_use += size;
+    mem_stats.used_blocks++;
+    mem_stats.used_class[size_class(size)]++;
+    mem_stats.pid_bytes[pid_slot(pid)] += size;
+    if (mem_stats.bytes_in_use > mem_stats.peak_in_use)
+    {
+        mem_stats.peak_in_use = mem_stats.bytes_in_use;
+    }
+}
+
+static void stats_remove_used(uint32_t size, int pid)
+{
+    mem_stats.bytes_in_use -= size;
+    mem_stats.used_blocks--;
+    mem_stats.used_class[size_class(size)]--;
+    mem_stats.pid_bytes[pid_slot(pid)] -= size;
+}
+
+/**
+ * Debug mode integrity helpers
+ *
+ * region_seal must be called after any change to a region header so that
+ * its checksum stays valid. In normal builds these compile away.
+ */
+#if MALLOC_DEBUG
+static const uint32_t canary_pattern[MEM_CANARY_SIZE / sizeof(uint32_t)] = {MEM_CANARY, MEM_CANARY};
+
+static uint32_t region_checksum(struct mem_region *region)
+{
+    return ((region->size << 1) | region->free) ^ region->pid ^ (region->requested << 7) ^
+        (uint32_t)(uintptr_t)region ^ MEM_CHECK_MAGIC;
+}
+
+/**
+ * The canary sits right after the requested bytes, so it need not be word
+ * aligned and is copied and compared a byte at a time.
+ */
+static uint8_t *region_canary(struct mem_region *region)
+{
+    return region->data + region->requested;
+}
+
+static void region_seal(struct mem_region *region)
+{
+    region->check = region_checksum(region);
+}
+
+static void region_set_requested(struct mem_region *region, uint32_t requested)
+{
+    region->requested = requested;
+}
+
+static void region_set_canary(struct mem_region *region)
+{
+    memcpy(region_canary(region), canary_pattern, MEM_CANARY_SIZE);
+}
+
+/**
+ * Returns: the number of bytes of region's data the caller may use
+ */
+static uint32_t region_usable(struct mem_region *region)
+{
+    return region->requested;
+}
+
+static int region_intact(struct mem_region *region)
+{
+    if (region->check != region_checksum(region))
+    {
+        return 0;
+    }
+    if (region->free == 0)
+    {
+        return memcmp(region_canary(region), canary_pattern, MEM_CANARY_SIZE) == 0;
+    }
+    return 1;
+}
+#else
+#define region_seal(region)
+#define region_set_requested(region, requested) ((void)(requested))
+#define region_set_canary(region)
+#define region_usable(region) ((region)->size)
+#define region_intact(region) 1
+#endif
+
 static void malloc_init(void) {
     pcb_init();
     const void *memory_start = (const void*)SDRAM_START;
     mymem = (struct mem_region*)memory_start;
     mymem->free = 1;
-    mymem->size = SDRAM_SIZE - sizeof(struct mem_region);
+    mymem->size = SDRAM_SIZE - MEM_INDEX_POOL_SIZE - SMALL_ZONE_SIZE - sizeof(struct mem_region);
     mymem->pid = get_pcb();
+    region_set_requested(mymem, 0);
+    region_seal(mymem);
+    void *index_pool = (void *)(SDRAM_START + SDRAM_SIZE - MEM_INDEX_POOL_SIZE);
+    mem_index_init(index_pool);
+    void *small_zone = (void *)(SDRAM_START + SDRAM_SIZE - MEM_INDEX_POOL_SIZE - SMALL_ZONE_SIZE);
+    small_init(small_zone, SMALL_ZONE_SIZE);
+    mem_index_insert(mymem);
+    memset(&mem_stats, 0, sizeof(mem_stats));
+    stats_add_free(mymem->size);
+    mem_stats.largest_free = mymem->size;
     malloc_initd = 1;
-    const void *memory_end = (const void*)SDRAM_END;
-    endmymem = (struct mem_region*)memory_end;
+    endmymem = (struct mem_region*)small_zone;
 }
 
 static int qword_boundary(int size)
@@ -70,17 +227,145 @@ static int qword_boundary(int size)
     return size - (size & (sizeof(Dword) - 1)) + sizeof(Dword);
 }
 
-void *myMalloc(uint32_t size) {
+/**
+ * Returns the allocated region whose data contains [p, p+len), or NULL if the
+ * range is not entirely inside a single allocated region. Small objects are
+ * not regions; see range_allocated.
+ */
+static struct mem_region *find_region_range(void *p, uint32_t len)
+{
+    if (p < (void *)mymem->data || p >= (void *)endmymem)
+    {
+        return NULL;
+    }
+    struct mem_region *region = mem_index_floor(p);
+    if (region == NULL || region->free == 1 || p < (void *)region->data)
+    {
+        return NULL;
+    }
+    uint32_t offset = (uint8_t *)p - region->data;
+    if (offset > region_usable(region) || len > region_usable(region) - offset)
+    {
+        return NULL;
+    }
+    return region;
+}
+
+static struct mem_region *find_region(void *p)
+{
+    return find_region_range(p, 0);
+}
+
+/**
+ * Returns 1 if [p, p+len) lies entirely inside one allocated object, whether
+ * it came from the small object zone or from a region.
+ */
+static int range_allocated(void *p, uint32_t len)
+{
+    if (small_contains(p))
+    {
+        return small_range_valid(p, len);
+    }
+    return find_region_range(p, len) != NULL;
+}
+
+/**
+ * Returns 1 if every byte of [p, p+len) equals val, 0 otherwise.
+ *
+ * Bytes are compared one at a time only until p is word aligned; the bulk
+ * of the range is compared a 32-bit word at a time against val replicated
+ * into every byte lane, and any remaining tail bytes are compared singly.
+ */
+static int bytes_equal(const uint8_t *p, uint8_t val, uint32_t len)
+{
+    while (len > 0 && ((uintptr_t)p & (sizeof(uint32_t) - 1)) != 0)
+    {
+        if (*p != val)
+        {
+            return 0;
+        }
+        p++;
+        len--;
+    }
+    const uint32_t pattern = val * 0x01010101u;
+    const uint32_t *word = (const uint32_t *)p;
+    while (len >= 4 * sizeof(uint32_t))
+    {
+        if ((word[0] ^ pattern) | (word[1] ^ pattern) | (word[2] ^ pattern) | (word[3] ^ pattern))
+        {
+            return 0;
+        }
+        word += 4;
+        len -= 4 * sizeof(uint32_t);
+    }
+    while (len >= sizeof(uint32_t))
+    {
+        if (*word != pattern)
+        {
+            return 0;
+        }
+        word++;
+        len -= sizeof(uint32_t);
+    }
+    p = (const uint8_t *)word;
+    while (len > 0)
+    {
+        if (*p != val)
+        {
+            return 0;
+        }
+        p++;
+        len--;
+    }
+    return 1;
+}
+
+static void *heap_alloc(uint32_t size) {
     if (size < 1) {
         return NULL;
     }
     if (malloc_initd == 0) {
         malloc_init();
     }
+    mem_stats.alloc_calls++;
+    if (size <= SMALL_MAX_SIZE && !MALLOC_DEBUG)
+    {
+        uint32_t class_size;
+        void *small = small_alloc(size, get_pcb(), &class_size);
+        if (small != NULL)
+        {
+            stats_add_used(class_size, get_pcb());
+            mem_stats.small_pages = small_pages_in_use();
+            return small;
+        }
+    }
+    uint32_t requested = size;
+    if (MALLOC_DEBUG) {
+        size += MEM_CANARY_SIZE;
+    }
     size = qword_boundary(size);
     struct mem_region *best = NULL;
+    // Track the two largest free blocks so that largest_free can be kept
+    // exact without another walk once best has been carved up.
+    struct mem_region *largest = NULL;
+    uint32_t second_largest_size = 0;
     struct mem_region *current = mymem;
     while (current < endmymem) {
+        if (current->free == 1)
+        {
+            if (largest == NULL || current->size >= largest->size)
+            {
+                if (largest != NULL)
+                {
+                    second_largest_size = largest->size;
+                }
+                largest = current;
+            }
+            else if (current->size > second_largest_size)
+            {
+                second_largest_size = current->size;
+            }
+        }
         // If we're giving them a pointer to the closest double word boundary that is on or
         // after current->data don't we need to make sure size is lte current->size +
         // distance to next double word boundary?
@@ -94,61 +379,137 @@ void *myMalloc(uint32_t size) {
         current = (void *)current + current->size + sizeof(struct mem_region);
     }
     if (best == NULL) {
+        mem_stats.failed_allocs++;
         return NULL;
     }
-    // Might have to use qword_boundary but probably not.
-    void *mp = best->data;
-    best->free = 0;
     // Need to split mp if best->size is gt size
     // The below math guarantees that if we split
     // the new_b->size will be gte 1 byte taking
     // into account overhead and padding.
-    if (best->size > size + sizeof(struct mem_region)) {
-        void *newloc = best->data + size;
+    // If the index has no room for another region the allocation fails
+    // rather than handing out the whole block.
+    void *newloc = best->data + size;
+    int split = best->size > size + sizeof(struct mem_region);
+    if (split && mem_index_insert((struct mem_region *)newloc) != E_SUCCESS) {
+        mem_stats.failed_allocs++;
+        return NULL;
+    }
+    // Might have to use qword_boundary but probably not.
+    void *mp = best->data;
+    best->free = 0;
+    stats_remove_free(best->size);
+    uint32_t remainder = 0;
+    if (split) {
         struct mem_region *new_b = (struct mem_region *)newloc;
         new_b->free = 1;
         new_b->size = best->size - size - sizeof(struct mem_region);
         new_b->pid = get_pcb();
+        region_set_requested(new_b, 0);
+        region_seal(new_b);
         best->size = size;
+        stats_add_free(new_b->size);
+        remainder = new_b->size;
+    }
+    best->pid = get_pcb();
+    region_set_requested(best, requested);
+    region_seal(best);
+    region_set_canary(best);
+    stats_add_used(best->size, best->pid);
+    // best was the only block that shrank, so the largest free block is either
+    // untouched, the runner up, or what is left of best after the split.
+    if (best == largest)
+    {
+        mem_stats.largest_free = remainder > second_largest_size ? remainder : second_largest_size;
+    }
+    else
+    {
+        mem_stats.largest_free = largest->size;
     }
     return mp;
 }
 
-int myFreeErrorCode(void *ptr) {
+/**
+ * The heap is shared by every process and by SVC handlers, so process
+ * switches are held off for the whole of an allocation or free. Otherwise a
+ * process switched out part way through would leave the region list
+ * inconsistent for the next one. No interrupt handler uses the heap, so
+ * device interrupts stay enabled; masking them for a whole best-fit walk
+ * would overrun the UART's receive FIFO.
+ */
+void *myMalloc(uint32_t size) {
+    uint32_t basepri = proc_sched_lock();
+    void *p = heap_alloc(size);
+    if (p != NULL)
+    {
+        mem_stats.bytes_allocated += size;
+    }
+    proc_sched_unlock(basepri);
+    return p;
+}
+
+static int heap_free(void *ptr) {
     if (malloc_initd == 0)
     {
         return E_ADDR_NOT_ALLOCATED;
     }
+    mem_stats.free_calls++;
     if (ptr == NULL) {
         return E_ADDR_NOT_ALLOCATED;
     }
-    struct mem_region *previous = NULL;
-    struct mem_region *current = mymem;
-    while (current < endmymem)
+    if (small_contains(ptr))
     {
-        if (current->data == ptr && current->free == 0) {
-            if (current->pid != get_pcb()) {
-                return E_WRONG_PID;
-            }
-            current->free = 1;
-            if (previous != NULL && previous->free == 1) {
-                previous->size = previous->size + current->size + sizeof(struct mem_region);
-                current = previous;
-            }
-            struct mem_region *next = (void *)current + current->size + sizeof(struct mem_region);
-            if (next < endmymem && next->free == 1) {
-                current->size = current->size + next->size + sizeof(struct mem_region);
-            }
-
-            return E_SUCCESS;
+        uint32_t class_size;
+        int small_status = small_free(ptr, get_pcb(), &class_size);
+        if (small_status == E_SUCCESS)
+        {
+            stats_remove_used(class_size, get_pcb());
+            mem_stats.small_pages = small_pages_in_use();
         }
-        previous = current;
-        current = (void *)current + current->size + sizeof(struct mem_region);
+        return small_status;
     }
-    return E_ADDR_NOT_ALLOCATED;
+    struct mem_region *current = find_region(ptr);
+    if (current == NULL || current->data != ptr) {
+        return E_ADDR_NOT_ALLOCATED;
+    }
+    if (!region_intact(current)) {
+        return E_HEAP_CORRUPT;
+    }
+    if (current->pid != get_pcb()) {
+        return E_WRONG_PID;
+    }
+    current->free = 1;
+    stats_remove_used(current->size, current->pid);
+    struct mem_region *previous = mem_index_prev(current);
+    if (previous != NULL && previous->free == 1) {
+        stats_remove_free(previous->size);
+        previous->size = previous->size + current->size + sizeof(struct mem_region);
+        mem_index_remove(current);
+        current = previous;
+    }
+    struct mem_region *next = (void *)current + current->size + sizeof(struct mem_region);
+    if (next < endmymem && next->free == 1) {
+        stats_remove_free(next->size);
+        current->size = current->size + next->size + sizeof(struct mem_region);
+        mem_index_remove(next);
+    }
+    region_seal(current);
+    stats_add_free(current->size);
+    // Coalescing only ever grows free blocks
+    if (current->size > mem_stats.largest_free)
+    {
+        mem_stats.largest_free = current->size;
+    }
+    return E_SUCCESS;
 }
 
 
+int myFreeErrorCode(void *ptr) {
+    uint32_t basepri = proc_sched_lock();
+    int status = heap_free(ptr);
+    proc_sched_unlock(basepri);
+    return status;
+}
+
 int myFree(void *ptr) {
     int myFreeStatus = myFreeErrorCode(ptr);
     if (myFreeStatus != E_SUCCESS) {
@@ -179,28 +540,135 @@ void memoryMap(void) {
         myprintf("%10p%5d%7s%12d\n", current->data, current->pid, *free, current->size);
         current = (void *)current + current->size + sizeof(struct mem_region);
     }
+    myprintf("\n%lu small object pages of %d bytes in use\n", (unsigned long)small_pages_in_use(), SMALL_PAGE_SIZE);
     myprintf("\n");
 }
 
-int myMemset(void *p, uint8_t val, long len)
+/**
+ * Address of the next region heapCheck will verify. Kept as an address rather
+ * than a region pointer because the region may be coalesced away between
+ * calls; the index maps it back to whichever region now owns it.
+ */
+static void *heap_check_cursor = NULL;
+
+/**
+ * Incrementally verify the heap, checking at most max_blocks regions per call
+ * and resuming where the previous call stopped. Each region must be indexed,
+ * must end inside the heap, must not be a free region following another free
+ * region, and in MALLOC_DEBUG builds must have an intact checksum and canary.
+ * The number of regions checked is returned in *checked.
+ * Returns: E_SUCCESS, or E_HEAP_CORRUPT with the offending region in *bad_region
+ */
+static int heap_check(uint32_t max_blocks, uint32_t *checked, void **bad_region)
 {
     if (malloc_initd == 0)
     {
-        return E_ADDR_NOT_ALLOCATED;
+        malloc_init();
     }
+    *checked = 0;
     struct mem_region *current = mymem;
-    while (current < endmymem)
+    if (heap_check_cursor != NULL)
     {
-        // Convert start pointer to an unsigned long so we can do integer math.
-        long start_addr = (long)p;
-        if ((void*)current->data <= p && (void*)(start_addr + len) <= (void*)(current->data + current->size))
+        current = mem_index_floor(heap_check_cursor);
+        if (current == NULL)
         {
-            memset(p, val, len);
-            return E_SUCCESS;
+            current = mymem;
         }
-        current = (void *)current + current->size + sizeof(struct mem_region);
     }
-    return E_ADDR_SPC;
+    struct mem_region *previous = mem_index_prev(current);
+    while (*checked < max_blocks)
+    {
+        struct mem_region *next = (void *)current + current->size + sizeof(struct mem_region);
+        if (mem_index_floor(current) != current ||
+            next > endmymem ||
+            (previous != NULL && previous->free == 1 && current->free == 1) ||
+            !region_intact(current))
+        {
+            *bad_region = current;
+            heap_check_cursor = NULL;
+            return E_HEAP_CORRUPT;
+        }
+        (*checked)++;
+        previous = current;
+        current = next;
+        if (current >= endmymem)
+        {
+            // Wrapped around; start from the bottom of the heap on the next call
+            current = mymem;
+            previous = NULL;
+        }
+    }
+    heap_check_cursor = current;
+    return E_SUCCESS;
+}
+
+int heapCheck(uint32_t max_blocks, uint32_t *checked, void **bad_region)
+{
+    uint32_t basepri = proc_sched_lock();
+    int status = heap_check(max_blocks, checked, bad_region);
+    proc_sched_unlock(basepri);
+    return status;
+}
+
+/**
+ * Copies the allocator statistics into stats. Runs in constant time.
+ */
+int myMemstat(struct mem_stats *stats)
+{
+    if (malloc_initd == 0)
+    {
+        malloc_init();
+    }
+    if (stats == NULL)
+    {
+        return E_ADDR_SPC;
+    }
+    memcpy(stats, &mem_stats, sizeof(struct mem_stats));
+    return E_SUCCESS;
+}
+
+/**
+ * Returns the number of bytes from p to the end of the object containing p
+ * if process pid allocated it, or 0 if p is not inside an object pid owns.
+ * Uses the region index, so runs in time logarithmic in the number of
+ * regions.
+ */
+uint32_t heapOwnedBytes(void *p, int pid)
+{
+    if (malloc_initd == 0)
+    {
+        return 0;
+    }
+    uint32_t basepri = proc_sched_lock();
+    uint32_t owned = 0;
+    if (small_contains(p))
+    {
+        owned = small_owned_bytes(p, pid);
+    }
+    else
+    {
+        struct mem_region *region = find_region(p);
+        if (region != NULL && region->pid == pid)
+        {
+            owned = region_usable(region) - ((uint8_t *)p - region->data);
+        }
+    }
+    proc_sched_unlock(basepri);
+    return owned;
+}
+
+int myMemset(void *p, uint8_t val, long len)
+{
+    if (malloc_initd == 0)
+    {
+        return E_ADDR_NOT_ALLOCATED;
+    }
+    if (len < 0 || !range_allocated(p, len))
+    {
+        return E_ADDR_SPC;
+    }
+    memset(p, val, len);
+    return E_SUCCESS;
 }
 
 int myMemchk(void *p, uint8_t val, long len)
@@ -210,27 +678,9 @@ int myMemchk(void *p, uint8_t val, long len)
         return E_ADDR_NOT_ALLOCATED;
     }
     int chkstatus = 0;
-    struct mem_region *current = mymem;
-    while (current < endmymem)
+    if (len >= 0 && range_allocated(p, len))
     {
-        // Convert start pointer to an unsigned long so we can do integer math.
-        long start_addr = (long)p;
-        if ((void *)current->data <= p && (void *)(start_addr + len) <= (void *)(current->data + current->size))
-        {
-            chkstatus = 1;
-            long current_byte = start_addr;
-            while (current_byte < start_addr + len)
-            {
-                unsigned char byte = *((unsigned char *)current_byte);
-                if ((uint8_t)byte != val) {
-                    chkstatus = 0;
-                    break;
-                }
-                current_byte++;
-            }
-            break;
-        }
-        current = (void *)current + current->size + sizeof(struct mem_region);
+        chkstatus = bytes_equal((const uint8_t *)p, val, len);
     }
     if (chkstatus == 0) {
         myprintf("%s\n", "memchk failed");
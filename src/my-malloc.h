@@ -2,6 +2,21 @@
 #define _MYMALLOC_H
 
 #include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * Set MALLOC_DEBUG to 1 to build the allocator with heap integrity checking:
+ * every region header carries a checksum, every allocated region has a
+ * canary straight after the bytes that were asked for, and both are verified
+ * by myFree and by heapCheck. Range checks stop at the requested size. Small
+ * object pages are bypassed in this mode so that every allocation gets a
+ * canary.
+ */
+#define MALLOC_DEBUG 0
+
+#define MEM_CHECK_MAGIC 0x5AFEC0DEu
+#define MEM_CANARY 0xDEADBEEFu
+#define MEM_CANARY_SIZE 8
 
 extern struct mem_region *mymem;
 extern struct mem_region *endmymem;
@@ -11,14 +26,51 @@ struct mem_region
     uint32_t free : 1;
     uint32_t size : 31;
     uint32_t pid;
+#if MALLOC_DEBUG
+    uint32_t check;
+    uint32_t requested; // bytes asked for, which the canary follows; also keeps data double word aligned
+#endif
     uint8_t data[0];
 };
 
+/**
+ * Allocator statistics
+ * 
+ * All counters are updated incrementally by myMalloc and myFree so that
+ * reading them is O(1).  Sizes exclude the struct mem_region header.
+ * Block counts are grouped into power of two size classes: class k holds
+ * blocks whose size is in [2^k, 2^(k+1)).
+ */
+#define MEM_STATS_MAX_PID 16
+#define MEM_STATS_SIZE_CLASSES 32
+
+struct mem_stats
+{
+    uint32_t bytes_in_use;
+    uint32_t bytes_free;
+    uint32_t peak_in_use;
+    uint32_t largest_free;
+    uint32_t used_blocks;
+    uint32_t free_blocks;
+    uint32_t alloc_calls;
+    uint32_t bytes_allocated; // total of the sizes of successful allocations
+    uint32_t free_calls;
+    uint32_t failed_allocs;
+    uint32_t small_pages;
+    // PIDs >= MEM_STATS_MAX_PID are accounted in the last entry
+    uint32_t pid_bytes[MEM_STATS_MAX_PID];
+    uint32_t used_class[MEM_STATS_SIZE_CLASSES];
+    uint32_t free_class[MEM_STATS_SIZE_CLASSES];
+};
+
 void *myMalloc(uint32_t size);
 int myFree(void *ptr);
 void memoryMap(void);
 int myFreeErrorCode(void *ptr);
 int myMemset(void *p, uint8_t val, long len);
 int myMemchk(void *p, uint8_t val, long len);
+int myMemstat(struct mem_stats *stats);
+int heapCheck(uint32_t max_blocks, uint32_t *checked, void **bad_region);
+uint32_t heapOwnedBytes(void *p, int pid);
 
 #endif /* ifndef _MYMALLOC_H */ 
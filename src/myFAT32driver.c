@@ -10,6 +10,7 @@
 #include "SDHC_FAT32_Files.h"
 #include "my-malloc.h"
 #include "utils.h"
+#include "devinutils.h"
 #include <string.h>
 
 Device FAT32;
@@ -97,5 +98,7 @@ int initFAT(void) {
     FAT32.fopen = fatfopen;
     FAT32.fdelete = fatfdelete;
     FAT32.fcreate = fatfcreate;
+    // Any path no other device claims is a file on the card
+    dev_register("/", &FAT32, DEV_PREFIX);
     return E_SUCCESS;
 }
@@ -8,60 +8,78 @@
 #include "myLEDdriver.h"
 #include "devinio.h"
 #include "led.h"
+#include "ledlevel.h"
+#include "pwm.h"
 #include "utils.h"
 #include "pcb.h"
 #include "devinutils.h"
 #include <stdint.h>
 #include <string.h>
 
+/**
+ * Implementation Notes
+ *
+ * Writing "on", "off" or a percentage such as "30%" sets an LED's
+ * brightness. The blue and orange LEDs are on FTM2 channels, so they are
+ * dimmed by hardware PWM at no cost to the CPU. The yellow and green LEDs
+ * (PTA28 and PTA29) have no timer channel on their pins, and toggling them
+ * from software would cost CPU time, so they are simply on for any level
+ * above 0%.
+ *
+ * Reading an LED still turns it off, as it always has.
+ */
+
+struct led
+{
+    char *path;
+    int channel; // FTM2 channel, or -1 if the LED can only be on or off
+    void (*on)(void);
+    void (*off)(void);
+};
+
+static struct led leds[] = {
+    {"/dev/ledy", -1, ledYellowOn, ledYellowOff},
+    {"/dev/ledg", -1, ledGreenOn, ledGreenOff},
+    {"/dev/ledb", PWM_CHANNEL_BLUE, ledBlueOn, ledBlueOff},
+    {"/dev/ledo", PWM_CHANNEL_ORANGE, ledOrangeOn, ledOrangeOff},
+};
+
 Device LEDGreen;
 Device LEDYellow;
 Device LEDBlue;
 Device LEDOrange;
 
-int ledfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
+static void led_set(struct led *led, uint32_t percent)
 {
-    char yellow[] = "/dev/ledy";
-    if (strcmp((char *)&(currentPCB->streams)[fd].pathname, &yellow[0]) == 0)
+    if (led->channel >= 0)
     {
-        ledYellowOff();
+        pwm_set(led->channel, led_level_counts(percent, PWM_PERIOD_COUNTS));
     }
-    char orange[] = "/dev/ledo";
-    if (strcmp((char *)&(currentPCB->streams)[fd].pathname, &orange[0]) == 0)
+    else if (percent > 0)
     {
-        ledOrangeOff();
+        led->on();
     }
-    char blue[] = "/dev/ledb";
-    if (strcmp((char *)&(currentPCB->streams)[fd].pathname, &blue[0]) == 0)
+    else
     {
-        ledBlueOff();
-    }
-    char green[] = "/dev/ledg";
-    if (strcmp((char *)&(currentPCB->streams)[fd].pathname, &green[0]) == 0)
-    {
-        ledGreenOff();
+        led->off();
     }
+}
+
+int ledfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
+{
+    led_set(stream_get(currentPCB, fd)->dev_data, 0);
     return E_SUCCESS;
 }
 
 int ledfputc(file_descriptor *fd, char *bufp, int buflen)
 {
-	char yellow[] = "/dev/ledy";
-    if (strcmp((char*)&(currentPCB->streams)[*fd].pathname,  &yellow[0]) == 0) {
-        ledYellowOn();
-    }
-	char orange[] = "/dev/ledo";
-    if (strcmp((char*)&(currentPCB->streams)[*fd].pathname,  &orange[0]) == 0) {
-        ledOrangeOn();
-    }
-	char blue[] = "/dev/ledb";
-    if (strcmp((char*)&(currentPCB->streams)[*fd].pathname,  &blue[0]) == 0) {
-        ledBlueOn();
-    }
-	char green[] = "/dev/ledg";
-    if (strcmp((char*)&(currentPCB->streams)[*fd].pathname,  &green[0]) == 0) {
-        ledGreenOn();
+    uint32_t percent;
+    int parse_status = led_level_parse(bufp, buflen, &percent);
+    if (parse_status != E_SUCCESS)
+    {
+        return parse_status;
     }
+    led_set(stream_get(currentPCB, *fd)->dev_data, percent);
     return E_SUCCESS;
 }
 
@@ -82,6 +100,13 @@ int ledfopen(char *pathname, file_descriptor *fd)
     {
         return get_stream_status;
     }
+    for (int i = 0; i < sizeof(leds) / sizeof(leds[0]); i++)
+    {
+        if (strcmp(pathname, leds[i].path) == 0)
+        {
+            stream_get(currentPCB, *fd)->dev_data = &leds[i];
+        }
+    }
     return E_SUCCESS;
 }
 
@@ -93,6 +118,7 @@ int initLED(void)
 {
     /* Initialize all of the LEDs */
     ledInitAll();
+    pwm_init();
     // Assign the green led functions
     LEDGreen.fgetc = ledfgetc;
     LEDGreen.fputc = ledfputc;
@@ -121,6 +147,10 @@ int initLED(void)
     LEDOrange.fdelete = ledfdelete;
     LEDOrange.fcreate = ledfcreate;
     LEDOrange.fopen = ledfopen;
+    dev_register("/dev/ledy", &LEDYellow, DEV_EXACT);
+    dev_register("/dev/ledg", &LEDGreen, DEV_EXACT);
+    dev_register("/dev/ledb", &LEDBlue, DEV_EXACT);
+    dev_register("/dev/ledo", &LEDOrange, DEV_EXACT);
     // Assign the yellow led functions
     return E_SUCCESS;
 }
@@ -0,0 +1,173 @@
+/**
+ * myMQdriver.c
+ * A driver for bounded message queues between processes
+ *
+ * Author: James Nicholson
+ */
+
+#include "myMQdriver.h"
+#include "devinutils.h"
+#include "my-malloc.h"
+#include "waitq.h"
+#include "utils.h"
+#include "pcb.h"
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Implementation Notes
+ *
+ * A message queue is a ring of fixed size message slots in SDRAM, allocated
+ * the first time the queue is opened and kept until reboot. Unlike a pipe,
+ * it keeps message boundaries: each write (all buflen bytes, NULs included)
+ * is one message, and each read returns exactly one message. A write waits
+ * while the queue is full and a read while it is empty. A read into a
+ * buffer too small for the next message fails with E_READ_LIMIT and leaves
+ * the message queued.
+ */
+
+struct mq
+{
+    uint32_t head; // messages taken since the queue was created
+    uint32_t tail; // messages put since the queue was created
+    struct wait_queue readers;
+    struct wait_queue writers;
+    uint16_t length[MQ_MAX_MESSAGES];
+    char message[MQ_MAX_MESSAGES][MQ_MESSAGE_SIZE];
+};
+
+static struct mq *queues[MQ_COUNT];
+
+// Returns the queue number in pathname, or -1 if it doesn't name a queue.
+static int mq_index(char *pathname)
+{
+    if (strncmp(pathname, MQ_PATH_PREFIX, strlen(MQ_PATH_PREFIX)) != 0)
+    {
+        return -1;
+    }
+    char *digits = pathname + strlen(MQ_PATH_PREFIX);
+    if (digits[0] < '0' || digits[0] >= '0' + MQ_COUNT || digits[1] != '\0')
+    {
+        return -1;
+    }
+    return digits[0] - '0';
+}
+
+int mqfopen(char *pathname, file_descriptor *fd)
+{
+    int index = mq_index(pathname);
+    if (index < 0)
+    {
+        return E_DEVICE_PATH;
+    }
+    int get_stream_status = get_available_stream(fd);
+    if (get_stream_status != E_SUCCESS)
+    {
+        return get_stream_status;
+    }
+    if (queues[index] == NULL)
+    {
+        struct mq *q = myMalloc(sizeof(struct mq));
+        if (q == NULL)
+        {
+            return E_MALLOC;
+        }
+        q->head = 0;
+        q->tail = 0;
+        q->readers.head = q->readers.tail = NULL;
+        q->writers.head = q->writers.tail = NULL;
+        queues[index] = q;
+    }
+    stream_get(currentPCB, *fd)->dev_data = queues[index];
+    return E_SUCCESS;
+}
+
+int mqfclose(file_descriptor *fd)
+{
+    return E_SUCCESS;
+}
+
+int mqfputc(file_descriptor *fd, char *bufp, int buflen)
+{
+    struct mq *q = stream_get(currentPCB, *fd)->dev_data;
+    if (buflen < 0 || buflen > MQ_MESSAGE_SIZE)
+    {
+        return E_WRITE_LIMIT;
+    }
+    int wait_status;
+    WAIT_EVENT_SVC(&q->writers, q->tail - q->head < MQ_MAX_MESSAGES, wait_status);
+    if (wait_status != E_SUCCESS)
+    {
+        return wait_status;
+    }
+    uint32_t slot = q->tail & (MQ_MAX_MESSAGES - 1);
+    memcpy(q->message[slot], bufp, buflen);
+    q->length[slot] = buflen;
+    q->tail++;
+    waitq_wake_all(&q->readers);
+    proc_poll_wake();
+    return E_SUCCESS;
+}
+
+int mqfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
+{
+    struct mq *q = stream_get(currentPCB, fd)->dev_data;
+    int wait_status;
+    WAIT_EVENT_SVC(&q->readers, q->tail != q->head, wait_status);
+    if (wait_status != E_SUCCESS)
+    {
+        return wait_status;
+    }
+    uint32_t slot = q->head & (MQ_MAX_MESSAGES - 1);
+    if (q->length[slot] > buflen)
+    {
+        return E_READ_LIMIT;
+    }
+    memcpy(bufp, q->message[slot], q->length[slot]);
+    *charsreadp = q->length[slot];
+    q->head++;
+    waitq_wake_all(&q->writers);
+    proc_poll_wake();
+    return E_SUCCESS;
+}
+
+int mqfready(file_descriptor fd)
+{
+    struct mq *q = stream_get(currentPCB, fd)->dev_data;
+    int ready = 0;
+    if (q->tail != q->head)
+    {
+        ready |= POLL_IN;
+    }
+    if (q->tail - q->head < MQ_MAX_MESSAGES)
+    {
+        ready |= POLL_OUT;
+    }
+    return ready;
+}
+
+int mqfdelete(char *pathname)
+{
+    return E_NOT_SUPPORTED;
+}
+
+int mqfcreate(char *pathname)
+{
+    return E_NOT_SUPPORTED;
+}
+
+Device MQ = {
+    .fgetc = mqfgetc,
+    .fputc = mqfputc,
+    .fopen = mqfopen,
+    .fdelete = mqfdelete,
+    .fclose = mqfclose,
+    .fcreate = mqfcreate,
+    .fflush = NULL,
+    .fready = mqfready,
+};
+
+int initMQ(void)
+{
+    return dev_register(MQ_PATH_PREFIX, &MQ, DEV_PREFIX);
+}
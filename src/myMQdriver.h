@@ -0,0 +1,30 @@
+/**
+ * myMQdriver.h
+ * A driver for bounded message queues between processes
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _MYMQDRIVER_H
+#define _MYMQDRIVER_H
+
+#include "devinio.h"
+
+/**
+ * Message queues are named /dev/mq0 to /dev/mq<MQ_COUNT - 1>.
+ */
+#define MQ_PATH_PREFIX "/dev/mq"
+#define MQ_COUNT 4
+
+/**
+ * Each queue holds up to MQ_MAX_MESSAGES messages of up to MQ_MESSAGE_SIZE
+ * bytes. MQ_MAX_MESSAGES must be a power of two.
+ */
+#define MQ_MAX_MESSAGES 16
+#define MQ_MESSAGE_SIZE 256
+
+extern Device MQ;
+
+int initMQ(void);
+
+#endif /* ifndef _MYMQDRIVER_H */
@@ -0,0 +1,108 @@
+/**
+ * myNULLdriver.c
+ * A driver for /dev/null and /dev/zero
+ *
+ * Author: James Nicholson
+ */
+
+#include "myNULLdriver.h"
+#include "devinutils.h"
+#include "utils.h"
+#include <stdint.h>
+
+/**
+ * Implementation Notes
+ *
+ * Both devices discard whatever is written to them. Reading /dev/null is
+ * always at end of file; reading /dev/zero fills the whole buffer with
+ * zeros. They do nothing else, so timing a copy to or from them measures
+ * the stream layer alone.
+ */
+
+int nullfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
+{
+    *charsreadp = 0;
+    return E_EOF;
+}
+
+/**
+ * Store bytes up to a word boundary, then whole words, then the bytes
+ * left over.
+ */
+int zerofgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
+{
+    char *p = bufp;
+    char *end = bufp + buflen;
+    while (p < end && ((uintptr_t)p & 3) != 0)
+    {
+        *p++ = 0;
+    }
+    uint32_t *word = (uint32_t *)p;
+    uint32_t *word_end = (uint32_t *)((uintptr_t)end & ~(uintptr_t)3);
+    while (word < word_end)
+    {
+        *word++ = 0;
+    }
+    p = (char *)word;
+    while (p < end)
+    {
+        *p++ = 0;
+    }
+    *charsreadp = buflen;
+    return E_SUCCESS;
+}
+
+int nullfputc(file_descriptor *fd, char *bufp, int buflen)
+{
+    return E_SUCCESS;
+}
+
+int nullfopen(char *pathname, file_descriptor *fd)
+{
+    return get_available_stream(fd);
+}
+
+int nullfclose(file_descriptor *fd)
+{
+    return E_SUCCESS;
+}
+
+int nullfdelete(char *pathname)
+{
+    return E_NOT_SUPPORTED;
+}
+
+int nullfcreate(char *pathname)
+{
+    return E_NOT_SUPPORTED;
+}
+
+Device DEVNULL = {
+    .fgetc = nullfgetc,
+    .fputc = nullfputc,
+    .fopen = nullfopen,
+    .fdelete = nullfdelete,
+    .fclose = nullfclose,
+    .fcreate = nullfcreate,
+    .fflush = NULL,
+};
+
+Device DEVZERO = {
+    .fgetc = zerofgetc,
+    .fputc = nullfputc,
+    .fopen = nullfopen,
+    .fdelete = nullfdelete,
+    .fclose = nullfclose,
+    .fcreate = nullfcreate,
+    .fflush = NULL,
+};
+
+int initNULL(void)
+{
+    int register_status = dev_register("/dev/null", &DEVNULL, DEV_EXACT);
+    if (register_status != E_SUCCESS)
+    {
+        return register_status;
+    }
+    return dev_register("/dev/zero", &DEVZERO, DEV_EXACT);
+}
@@ -0,0 +1,21 @@
+/**
+ * myNULLdriver.h
+ * A driver for /dev/null and /dev/zero
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _MYNULLDRIVER_H
+#define _MYNULLDRIVER_H
+
+#include "devinio.h"
+
+extern Device DEVNULL;
+extern Device DEVZERO;
+
+/**
+ * Register /dev/null and /dev/zero.
+ */
+int initNULL(void);
+
+#endif /* ifndef _MYNULLDRIVER_H */
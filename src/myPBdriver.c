@@ -7,23 +7,160 @@
 
 #include "myPBdriver.h"
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include "derivative.h"
 #include "devinio.h"
 #include "switchcmd.h"
+#include "pushbutton.h"
 #include "utils.h"
 #include "devinutils.h"
+#include "clock.h"
+#include "nvic.h"
+#include "proc.h"
+#include "waitq.h"
+#include "pcb.h"
+
+/**
+ * Implementation Notes
+ *
+ * Each button's pin interrupts on both edges. The port handler only notes
+ * the time of the first edge and (re)starts the button's debounce timer on
+ * kernel_timers, so a bouncing contact keeps pushing the timer back. When
+ * the timer finally expires the pin has been quiet for PB_DEBOUNCE_MS; if
+ * its level differs from the last one reported, an event stamped with the
+ * time of that first edge is queued and readers are woken. Nothing runs
+ * while the buttons are left alone.
+ *
+ * A read waits for at least one event and returns as many whole events as
+ * fit in the buffer, one line each: the switchState code (1 sw1 down, 2 sw1
+ * up, 3 sw2 down, 4 sw2 up) and the milliseconds since boot, i.e. "1 5230".
+ * Every stream open on a button shares its queue.
+ *
+ * Edges before the scheduler starts are ignored, since kernel_timers is not
+ * set up until then.
+ */
+
+#define PB_PORT_IRQC_EITHER_EDGE 0xB
+#define PB_EVENT_LINE_MAX 16
+
+struct pb_event
+{
+    uint8_t code; // an enum switchState value
+    uint32_t ms; // when the change began
+};
+
+struct pushbutton
+{
+    PORT_MemMapPtr port;
+    int bit;
+    int (*pressed)(void);
+    uint8_t down_code;
+    uint8_t up_code;
+    int reported; // last level queued, 1 for pressed
+    int bouncing; // an edge has been seen and the timer is running
+    uint32_t edge_ms;
+    struct timer debounce;
+    volatile uint32_t head; // events taken by readers
+    volatile uint32_t tail; // events queued by the timer
+    struct pb_event events[PB_MAX_EVENTS];
+    struct wait_queue readers;
+};
+
+static struct pushbutton buttons[2];
 
 Device SW1;
 Device SW2;
 
+// Runs from SysTick once the pin has settled.
+static void pb_settled(struct timer *t)
+{
+    struct pushbutton *b = t->arg;
+    b->bouncing = 0;
+    int level = b->pressed();
+    if (level == b->reported)
+    {
+        return;
+    }
+    b->reported = level;
+    if (b->tail - b->head == PB_MAX_EVENTS)
+    {
+        return;
+    }
+    struct pb_event *e = &b->events[b->tail % PB_MAX_EVENTS];
+    e->code = level ? b->down_code : b->up_code;
+    e->ms = b->edge_ms;
+    b->tail++;
+    waitq_wake_all(&b->readers);
+    proc_poll_wake();
+}
+
+static void pb_edge(struct pushbutton *b)
+{
+    PORT_ISFR_REG(b->port) = 1 << b->bit;
+    if (!proc_started())
+    {
+        return;
+    }
+    uint32_t primask = proc_irq_save();
+    if (!b->bouncing)
+    {
+        b->bouncing = 1;
+        b->edge_ms = (uint32_t)(clock_us() / 1000);
+    }
+    timer_add(&kernel_timers, &b->debounce,
+        kernel_timers.now + (PB_DEBOUNCE_MS * SCHED_TICK_HZ + 999) / 1000);
+    proc_irq_restore(primask);
+}
+
+void portDHandler(void)
+{
+    pb_edge(&buttons[0]);
+}
+
+void portEHandler(void)
+{
+    pb_edge(&buttons[1]);
+}
+
 int pbfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
 {
-    char pbscan = switchScan() + '0';
-    strncpy(&bufp[0], &pbscan, 1);
-    *charsreadp = 1;
+    struct pushbutton *b = stream_get(currentPCB, fd)->dev_data;
+    int wait_status;
+    WAIT_EVENT_SVC(&b->readers, b->tail != b->head, wait_status);
+    if (wait_status != E_SUCCESS)
+    {
+        return wait_status;
+    }
+    int charsread = 0;
+    while (b->head != b->tail)
+    {
+        struct pb_event *e = &b->events[b->head % PB_MAX_EVENTS];
+        char line[PB_EVENT_LINE_MAX];
+        int len = snprintf(line, sizeof(line), "%d %lu\n", e->code, (unsigned long)e->ms);
+        if (charsread + len > buflen)
+        {
+            break;
+        }
+        memcpy(bufp + charsread, line, len);
+        charsread += len;
+        b->head++;
+    }
+    if (charsread == 0)
+    {
+        return E_READ_LIMIT;
+    }
+    *charsreadp = charsread;
     return E_SUCCESS;
 }
 
+// Writes fail at once, so never wait.
+int pbfready(file_descriptor fd)
+{
+    struct pushbutton *b = stream_get(currentPCB, fd)->dev_data;
+    return b->tail != b->head ? POLL_IN | POLL_OUT : POLL_OUT;
+}
+
 int pbfputc(file_descriptor *fd, char *bufp, int buflen)
 {
     return E_NOT_SUPPORTED;
@@ -51,13 +188,34 @@ int pbfopen(char *filename, file_descriptor *fd)
     {
         return get_stream_status;
     }
+    stream_get(currentPCB, *fd)->dev_data = strcmp(filename, "/dev/sw1") == 0 ? &buttons[0] : &buttons[1];
     return E_SUCCESS;
 }
 
+static void pb_setup(struct pushbutton *b, PORT_MemMapPtr port, int bit, int (*pressed)(void),
+    enum switchState down_code, enum switchState up_code)
+{
+    b->port = port;
+    b->bit = bit;
+    b->pressed = pressed;
+    b->down_code = down_code;
+    b->up_code = up_code;
+    b->reported = pressed();
+    b->bouncing = 0;
+    b->head = b->tail = 0;
+    b->readers.head = b->readers.tail = NULL;
+    timer_init(&b->debounce, pb_settled, b);
+    PORT_PCR_REG(port, bit) |= PORT_PCR_ISF_MASK | PORT_PCR_IRQC(PB_PORT_IRQC_EITHER_EDGE);
+}
+
 int initPB(void)
 {
     /* Initialize the push buttons */
     switchcmdInit();
+    pb_setup(&buttons[0], PORTD_BASE_PTR, PUSHBUTTON_SW1_PORTD_BIT, sw1In, switch1Down, switch1Up);
+    pb_setup(&buttons[1], PORTE_BASE_PTR, PUSHBUTTON_SW2_PORTE_BIT, sw2In, switch2Down, switch2Up);
+    nvic_enable_irq(PORTD_IRQ_NUMBER, PB_INTERRUPT_PRIORITY);
+    nvic_enable_irq(PORTE_IRQ_NUMBER, PB_INTERRUPT_PRIORITY);
     // Define functions for SW1
     SW1.fgetc = pbfgetc;
     SW1.fputc = pbfputc;
@@ -65,6 +223,7 @@ int initPB(void)
     SW1.fdelete = pbfdelete;
     SW1.fcreate = pbfcreate;
     SW1.fopen = pbfopen;
+    SW1.fready = pbfready;
     // Define functions for SW2
     SW2.fgetc = pbfgetc;
     SW2.fputc = pbfputc;
@@ -72,5 +231,8 @@ int initPB(void)
     SW2.fdelete = pbfdelete;
     SW2.fcreate = pbfcreate;
     SW2.fopen = pbfopen;
+    SW2.fready = pbfready;
+    dev_register("/dev/sw1", &SW1, DEV_EXACT);
+    dev_register("/dev/sw2", &SW2, DEV_EXACT);
     return E_SUCCESS;
 }
@@ -10,9 +10,28 @@
 
 #include "devinio.h"
 
+/**
+ * IRQ numbers (vector number minus 16) of the ports the buttons are on, and
+ * the priority both run at. SW1 is PTD0 and SW2 is PTE26.
+ */
+#define PORTD_IRQ_NUMBER 90
+#define PORTE_IRQ_NUMBER 91
+#define PB_INTERRUPT_PRIORITY 9
+
+/**
+ * A button must stay in a new state for PB_DEBOUNCE_MS before the change is
+ * reported. Each button queues up to PB_MAX_EVENTS changes; later ones are
+ * dropped until a reader catches up.
+ */
+#define PB_DEBOUNCE_MS 20
+#define PB_MAX_EVENTS 16
+
 int initPB(void);
 
+void portDHandler(void);
+void portEHandler(void);
+
 extern Device SW1;
 extern Device SW2;
 
-#endif /* ifndef _MYPBDRIVER_H */
\ No newline at end of file
+#endif /* ifndef _MYPBDRIVER_H */
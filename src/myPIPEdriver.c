@@ -0,0 +1,182 @@
+/**
+ * myPIPEdriver.c
+ * A driver for pipes between processes
+ *
+ * Author: James Nicholson
+ */
+
+#include "myPIPEdriver.h"
+#include "devinutils.h"
+#include "my-malloc.h"
+#include "ringbuf.h"
+#include "waitq.h"
+#include "utils.h"
+#include "pcb.h"
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Implementation Notes
+ *
+ * Each pipe is a ring buffer in SDRAM, allocated the first time the pipe is
+ * opened. Pipes are named and outlive the processes using them, like FIFOs,
+ * so a pipe and its contents stay until reboot.
+ *
+ * Streams have no read or write mode, so a reader sees end of file (E_EOF)
+ * when the pipe is empty and no other stream has it open. Otherwise a read
+ * waits for at least one byte and returns what is there, up to buflen. A
+ * write waits until the whole buffer fits, so writes from different
+ * processes never interleave. As with stdout, a write stops at the first
+ * NUL, so the shell's write command sends just its text.
+ */
+
+struct pipe
+{
+    struct ringbuf ring;
+    uint32_t opens; // streams that have the pipe open
+    struct wait_queue readers;
+    struct wait_queue writers;
+};
+
+static struct pipe *pipes[PIPE_COUNT];
+
+// Returns the pipe number in pathname, or -1 if it doesn't name a pipe.
+static int pipe_index(char *pathname)
+{
+    if (strncmp(pathname, PIPE_PATH_PREFIX, strlen(PIPE_PATH_PREFIX)) != 0)
+    {
+        return -1;
+    }
+    char *digits = pathname + strlen(PIPE_PATH_PREFIX);
+    if (digits[0] < '0' || digits[0] >= '0' + PIPE_COUNT || digits[1] != '\0')
+    {
+        return -1;
+    }
+    return digits[0] - '0';
+}
+
+int pipefopen(char *pathname, file_descriptor *fd)
+{
+    int index = pipe_index(pathname);
+    if (index < 0)
+    {
+        return E_DEVICE_PATH;
+    }
+    int get_stream_status = get_available_stream(fd);
+    if (get_stream_status != E_SUCCESS)
+    {
+        return get_stream_status;
+    }
+    if (pipes[index] == NULL)
+    {
+        struct pipe *p = myMalloc(sizeof(struct pipe) + PIPE_BUFFER_SIZE);
+        if (p == NULL)
+        {
+            return E_MALLOC;
+        }
+        ringbuf_init(&p->ring, (uint8_t *)(p + 1), PIPE_BUFFER_SIZE);
+        p->opens = 0;
+        p->readers.head = p->readers.tail = NULL;
+        p->writers.head = p->writers.tail = NULL;
+        pipes[index] = p;
+    }
+    pipes[index]->opens++;
+    stream_get(currentPCB, *fd)->dev_data = pipes[index];
+    return E_SUCCESS;
+}
+
+int pipefclose(file_descriptor *fd)
+{
+    struct pipe *p = stream_get(currentPCB, *fd)->dev_data;
+    p->opens--;
+    // A reader may now be the only one left, and so at end of file
+    waitq_wake_all(&p->readers);
+    proc_poll_wake();
+    return E_SUCCESS;
+}
+
+int pipefputc(file_descriptor *fd, char *bufp, int buflen)
+{
+    struct pipe *p = stream_get(currentPCB, *fd)->dev_data;
+    uint32_t len = strnlen(bufp, buflen);
+    if (len > PIPE_BUFFER_SIZE)
+    {
+        return E_WRITE_LIMIT;
+    }
+    int wait_status;
+    WAIT_EVENT_SVC(&p->writers, ringbuf_space(&p->ring) >= len, wait_status);
+    if (wait_status != E_SUCCESS)
+    {
+        return wait_status;
+    }
+    ringbuf_write(&p->ring, (const uint8_t *)bufp, len);
+    waitq_wake_all(&p->readers);
+    proc_poll_wake();
+    return E_SUCCESS;
+}
+
+int pipefgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
+{
+    struct pipe *p = stream_get(currentPCB, fd)->dev_data;
+    int wait_status;
+    WAIT_EVENT_SVC(&p->readers, ringbuf_count(&p->ring) > 0 || p->opens == 1, wait_status);
+    if (wait_status != E_SUCCESS)
+    {
+        return wait_status;
+    }
+    *charsreadp = ringbuf_read(&p->ring, (uint8_t *)bufp, buflen);
+    if (*charsreadp == 0)
+    {
+        return E_EOF;
+    }
+    waitq_wake_all(&p->writers);
+    proc_poll_wake();
+    return E_SUCCESS;
+}
+
+/**
+ * A pipe at end of file is readable, since a read returns at once. A write
+ * waits until all of its bytes fit, so the pipe is only reported writable
+ * when a write of the largest allowed length, PIPE_BUFFER_SIZE bytes, would
+ * not wait. A shorter write may still succeed while POLL_OUT is clear.
+ */
+int pipefready(file_descriptor fd)
+{
+    struct pipe *p = stream_get(currentPCB, fd)->dev_data;
+    int ready = 0;
+    if (ringbuf_count(&p->ring) > 0 || p->opens == 1)
+    {
+        ready |= POLL_IN;
+    }
+    if (ringbuf_space(&p->ring) >= PIPE_BUFFER_SIZE)
+    {
+        ready |= POLL_OUT;
+    }
+    return ready;
+}
+
+int pipefdelete(char *pathname)
+{
+    return E_NOT_SUPPORTED;
+}
+
+int pipefcreate(char *pathname)
+{
+    return E_NOT_SUPPORTED;
+}
+
+Device PIPE = {
+    .fgetc = pipefgetc,
+    .fputc = pipefputc,
+    .fopen = pipefopen,
+    .fdelete = pipefdelete,
+    .fclose = pipefclose,
+    .fcreate = pipefcreate,
+    .fflush = NULL,
+    .fready = pipefready,
+};
+
+int initPIPE(void)
+{
+    return dev_register(PIPE_PATH_PREFIX, &PIPE, DEV_PREFIX);
+}
@@ -0,0 +1,29 @@
+/**
+ * myPIPEdriver.h
+ * A driver for pipes between processes
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _MYPIPEDRIVER_H
+#define _MYPIPEDRIVER_H
+
+#include "devinio.h"
+
+/**
+ * Pipes are named /dev/pipe0 to /dev/pipe<PIPE_COUNT - 1>.
+ */
+#define PIPE_PATH_PREFIX "/dev/pipe"
+#define PIPE_COUNT 4
+
+/**
+ * Size in bytes of each pipe's ring buffer. Must be a power of two. A write
+ * of up to this many bytes is atomic; a longer one is refused.
+ */
+#define PIPE_BUFFER_SIZE 4096
+
+extern Device PIPE;
+
+int initPIPE(void);
+
+#endif /* ifndef _MYPIPEDRIVER_H */
@@ -0,0 +1,304 @@
+/**
+ * mySTDSTRMdriver.c
+ * A driver for the buffered standard streams stdin, stdout and stderr
+ *
+ * Author: James Nicholson
+ */
+
+#include "mySTDSTRMdriver.h"
+#include "devinio.h"
+#include "devinutils.h"
+#include "my-malloc.h"
+#include "uart.h"
+#include "uartNL.h"
+#include "utils.h"
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Implementation Notes
+ *
+ * All three streams are backed by the UART2 console. stdout collects
+ * output in its buffer and hands it to the UART driver in one uartWriteNL
+ * call, which is large enough to go out by DMA. stdin collects a line from the
+ * console in its buffer and returns it in pieces of whatever size the caller
+ * asks for; while the line is being typed the reading process sleeps on the
+ * UART's receive queue. stdout is flushed before stdin waits for input and
+ * before stderr writes, so prompts and error messages appear in order.
+ *
+ * The Devices are initialized statically rather than in an init function
+ * because every pcb, including the one created by the first myMalloc,
+ * refers to them from the start.
+ */
+
+static int stdstrm_get_buffer(Stream *stream, uint32_t size)
+{
+    if (stream->buffer == NULL)
+    {
+        stream->buffer = myMalloc(size);
+        if (stream->buffer == NULL)
+        {
+            return E_MALLOC;
+        }
+        stream->buffer_size = size;
+        stream->buffer_used = 0;
+        stream->buffer_pos = 0;
+    }
+    return E_SUCCESS;
+}
+
+int stdoutfflush(file_descriptor *fd)
+{
+    Stream *stream = stream_get(currentPCB, *fd);
+    if (stream->buffer_used > 0)
+    {
+        uartWriteNL(UART2_BASE_PTR, stream->buffer, stream->buffer_used);
+        stream->buffer_used = 0;
+    }
+    return E_SUCCESS;
+}
+
+void stdout_flush(void)
+{
+    file_descriptor fd = STDOUT_FD;
+    if (stream_get(currentPCB, fd)->in_use && stream_get(currentPCB, fd)->device == &STDOUT)
+    {
+        stdoutfflush(&fd);
+    }
+}
+
+/**
+ * Writes stop at buflen characters or the first NUL, whichever comes first.
+ */
+int stdoutfputc(file_descriptor *fd, char *bufp, int buflen)
+{
+    Stream *stream = stream_get(currentPCB, *fd);
+    int get_buffer_status = stdstrm_get_buffer(stream, STDOUT_BUFFER_SIZE);
+    if (get_buffer_status != E_SUCCESS)
+    {
+        return get_buffer_status;
+    }
+    uint32_t len = strnlen(bufp, buflen);
+    while (len > 0)
+    {
+        uint32_t room = stream->buffer_size - stream->buffer_used;
+        if (room == 0)
+        {
+            stdoutfflush(fd);
+            room = stream->buffer_size;
+        }
+        uint32_t n = len < room ? len : room;
+        memcpy(&stream->buffer[stream->buffer_used], bufp, n);
+        stream->buffer_used += n;
+        bufp += n;
+        len -= n;
+    }
+    if (STDOUT_LINE_BUFFERED && memchr(stream->buffer, '\n', stream->buffer_used) != NULL)
+    {
+        stdoutfflush(fd);
+    }
+    return E_SUCCESS;
+}
+
+int stderrfputc(file_descriptor *fd, char *bufp, int buflen)
+{
+    stdout_flush();
+    uartWriteNL(UART2_BASE_PTR, bufp, strnlen(bufp, buflen));
+    return E_SUCCESS;
+}
+
+// A whole line, ending in its new-line, is waiting in stdin's buffer.
+static int stdin_line_complete(Stream *stream)
+{
+    return stream->buffer_used > 0 && stream->buffer[stream->buffer_used - 1] == '\n';
+}
+
+/**
+ * Reads console characters into stdin's buffer until the line is complete,
+ * echoing them and applying backspaces as uartGetline does. The partial line
+ * is kept in the buffer, so when no character is waiting this can return
+ * E_BLOCKED and carry on from the same place when the SVC is run again.
+ */
+static int stdin_read_line(Stream *stream)
+{
+    while (!stdin_line_complete(stream))
+    {
+        char c;
+        int status = uart2GetcharSVC(&c);
+        if (status != E_SUCCESS)
+        {
+            return status;
+        }
+        if (c == UARTNL_BACKSPACE_CHAR || c == UARTNL_DELETE_CHAR)
+        {
+            if (stream->buffer_used > 0)
+            {
+                uartPuts(UART2_BASE_PTR, "\b \b");
+                stream->buffer_used--;
+            }
+        }
+        else if (c == UARTNL_END_OF_INPUT_LINE_CHAR)
+        {
+            uartPuts(UART2_BASE_PTR, "\r\n");
+            stream->buffer[stream->buffer_used++] = '\n';
+        }
+        else
+        {
+            uartPutchar(UART2_BASE_PTR, c);
+            stream->buffer[stream->buffer_used++] = c;
+            // Like uartGetline, end the line once the buffer is full.
+            if (stream->buffer_used == stream->buffer_size - 1)
+            {
+                stream->buffer[stream->buffer_used++] = '\n';
+            }
+        }
+    }
+    return E_SUCCESS;
+}
+
+/**
+ * Copies up to buflen characters of the current input line, including its
+ * terminating new-line, into bufp. Only reads the console when everything
+ * from the previous line has been returned, and then one character at a
+ * time, so the caller sleeps rather than the SVC handler spinning while
+ * the line is typed.
+ */
+int stdinfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
+{
+    Stream *stream = stream_get(currentPCB, fd);
+    int get_buffer_status = stdstrm_get_buffer(stream, STDIN_BUFFER_SIZE);
+    if (get_buffer_status != E_SUCCESS)
+    {
+        return get_buffer_status;
+    }
+    if (stdin_line_complete(stream) && stream->buffer_pos == stream->buffer_used)
+    {
+        stream->buffer_used = 0;
+        stream->buffer_pos = 0;
+    }
+    if (!stdin_line_complete(stream))
+    {
+        stdout_flush();
+        int read_status = stdin_read_line(stream);
+        if (read_status != E_SUCCESS)
+        {
+            return read_status;
+        }
+    }
+    uint32_t n = stream->buffer_used - stream->buffer_pos;
+    if (n > buflen)
+    {
+        n = buflen;
+    }
+    memcpy(bufp, &stream->buffer[stream->buffer_pos], n);
+    stream->buffer_pos += n;
+    *charsreadp = n;
+    return E_SUCCESS;
+}
+
+/**
+ * stdin is readable once part of a line is buffered or the console has
+ * received a character. Writes to it fail at once, so never wait.
+ */
+int stdinfready(file_descriptor fd)
+{
+    Stream *stream = stream_get(currentPCB, fd);
+    if ((stream->buffer != NULL && stdin_line_complete(stream) &&
+         stream->buffer_pos < stream->buffer_used) ||
+        uartGetcharPresent(UART2_BASE_PTR))
+    {
+        return POLL_IN | POLL_OUT;
+    }
+    return POLL_OUT;
+}
+
+int stdstrmfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
+{
+    return E_NOT_SUPPORTED;
+}
+
+int stdstrmfputc(file_descriptor *fd, char *bufp, int buflen)
+{
+    return E_NOT_SUPPORTED;
+}
+
+int stdstrmfclose(file_descriptor *fd)
+{
+    Stream *stream = stream_get(currentPCB, *fd);
+    if (stream->device == &STDOUT)
+    {
+        stdoutfflush(fd);
+    }
+    if (stream->buffer != NULL)
+    {
+        myFree(stream->buffer);
+        stream->buffer = NULL;
+    }
+    return E_SUCCESS;
+}
+
+/**
+ * The standard streams are opened by stdstrm_attach, not by path.
+ */
+int stdstrmfopen(char *pathname, file_descriptor *fd)
+{
+    return E_NOT_SUPPORTED;
+}
+
+int stdstrmfdelete(char *pathname)
+{
+    return E_NOT_SUPPORTED;
+}
+
+int stdstrmfcreate(char *pathname)
+{
+    return E_NOT_SUPPORTED;
+}
+
+Device STDIN = {
+    .fgetc = stdinfgetc,
+    .fputc = stdstrmfputc,
+    .fopen = stdstrmfopen,
+    .fdelete = stdstrmfdelete,
+    .fclose = stdstrmfclose,
+    .fcreate = stdstrmfcreate,
+    .fflush = NULL,
+    .fready = stdinfready,
+};
+
+Device STDOUT = {
+    .fgetc = stdstrmfgetc,
+    .fputc = stdoutfputc,
+    .fopen = stdstrmfopen,
+    .fdelete = stdstrmfdelete,
+    .fclose = stdstrmfclose,
+    .fcreate = stdstrmfcreate,
+    .fflush = stdoutfflush,
+};
+
+Device STDERR = {
+    .fgetc = stdstrmfgetc,
+    .fputc = stderrfputc,
+    .fopen = stdstrmfopen,
+    .fdelete = stdstrmfdelete,
+    .fclose = stdstrmfclose,
+    .fcreate = stdstrmfcreate,
+    .fflush = NULL,
+};
+
+void stdstrm_attach(struct pcb *pcb)
+{
+    Device *devices[] = {&STDIN, &STDOUT, &STDERR};
+    char *paths[] = {"/dev/stdin", "/dev/stdout", "/dev/stderr"};
+    for (int fd = STDIN_FD; fd <= STDERR_FD; fd++)
+    {
+        Stream *stream = stream_get(pcb, fd);
+        stream->device = devices[fd];
+        strncpy(stream->pathname, paths[fd], sizeof(stream->pathname));
+        stream->buffer = NULL;
+        stream->buffer_size = 0;
+        stream->buffer_used = 0;
+        stream->buffer_pos = 0;
+        stream_set_open(pcb, fd, 1);
+    }
+}
@@ -0,0 +1,48 @@
+/**
+ * mySTDSTRMdriver.h
+ * A driver for the buffered standard streams stdin, stdout and stderr
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _MYSTDSTRMDRIVER_H
+#define _MYSTDSTRMDRIVER_H
+
+#include "devinio.h"
+#include "pcb.h"
+
+/**
+ * File descriptors of the standard streams, open in every process.
+ */
+#define STDIN_FD 0
+#define STDOUT_FD 1
+#define STDERR_FD 2
+
+/**
+ * Buffer sizes. stderr is unbuffered, so it has none.
+ */
+#define STDIN_BUFFER_SIZE 256
+#define STDOUT_BUFFER_SIZE 8192
+
+/**
+ * Set to 1 to flush stdout at every new-line instead of only when its
+ * buffer fills, when stdin or stderr is used, or on an explicit myfflush.
+ */
+#define STDOUT_LINE_BUFFERED 0
+
+extern Device STDIN;
+extern Device STDOUT;
+extern Device STDERR;
+
+/**
+ * Flush the current process's stdout if it is still the standard stream.
+ */
+void stdout_flush(void);
+
+/**
+ * Open the standard streams as file descriptors 0, 1 and 2 of pcb. Their
+ * buffers are allocated by the process itself the first time it uses them.
+ */
+void stdstrm_attach(struct pcb *pcb);
+
+#endif /* ifndef _MYSTDSTRMDRIVER_H */
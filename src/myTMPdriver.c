@@ -0,0 +1,347 @@
+/**
+ * myTMPdriver.c
+ * A RAM disk in SDRAM mounted at /tmp
+ *
+ * Author: James Nicholson
+ */
+
+#include "myTMPdriver.h"
+#include "devinutils.h"
+#include "my-malloc.h"
+#include "utils.h"
+#include "pcb.h"
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Implementation Notes
+ *
+ * The disk is one array of fixed size blocks. Like FAT, each file is a
+ * chain of blocks linked through a next-block table, and free blocks are
+ * chained the same way, so allocating or freeing a block is O(1) and a file
+ * never needs contiguous space. A file remembers its last block, so
+ * appending never walks the chain; a stream remembers the block it is
+ * reading, so reading never walks it either.
+ *
+ * As on the card, writes append to the end of the file and stop at the
+ * first NUL, and each stream reads from the start of the file.
+ */
+
+#define TMP_NO_BLOCK 0xFFFFFFFF
+
+struct tmp_file
+{
+    char name[TMP_NAME_MAX + 1]; // empty if the entry is unused
+    uint32_t size;
+    uint32_t first_block;
+    uint32_t last_block;
+    uint32_t opens;
+};
+
+// The block data and the next-block table share one SDRAM allocation
+static uint8_t *blocks = NULL;
+static uint32_t *next_block = NULL;
+static uint32_t free_head = TMP_NO_BLOCK;
+static uint32_t free_count = 0;
+static struct tmp_file files[TMP_MAX_FILES];
+
+static uint32_t block_alloc(void)
+{
+    uint32_t block = free_head;
+    free_head = next_block[block];
+    next_block[block] = TMP_NO_BLOCK;
+    free_count--;
+    return block;
+}
+
+static void block_free_chain(uint32_t block)
+{
+    while (block != TMP_NO_BLOCK)
+    {
+        uint32_t next = next_block[block];
+        next_block[block] = free_head;
+        free_head = block;
+        free_count++;
+        block = next;
+    }
+}
+
+// Returns the name part of a /tmp/ path, or NULL if it is empty or too long.
+static char *tmp_name(char *pathname)
+{
+    char *name = pathname + strlen(TMP_PATH_PREFIX);
+    size_t len = strlen(name);
+    if (len == 0 || len > TMP_NAME_MAX)
+    {
+        return NULL;
+    }
+    return name;
+}
+
+static struct tmp_file *tmp_find(char *name)
+{
+    for (int i = 0; i < TMP_MAX_FILES; i++)
+    {
+        if (files[i].name[0] != '\0' && strcmp(files[i].name, name) == 0)
+        {
+            return &files[i];
+        }
+    }
+    return NULL;
+}
+
+int tmpfcreate(char *pathname)
+{
+    char *name = tmp_name(pathname);
+    if (name == NULL)
+    {
+        return E_FILE_NAME_INVALID;
+    }
+    if (tmp_find(name) != NULL)
+    {
+        return E_FILE_EXISTS;
+    }
+    for (int i = 0; i < TMP_MAX_FILES; i++)
+    {
+        if (files[i].name[0] == '\0')
+        {
+            strcpy(files[i].name, name);
+            files[i].size = 0;
+            files[i].first_block = TMP_NO_BLOCK;
+            files[i].last_block = TMP_NO_BLOCK;
+            files[i].opens = 0;
+            return E_SUCCESS;
+        }
+    }
+    return E_NO_FREE_CLUSTER;
+}
+
+int tmpfdelete(char *pathname)
+{
+    char *name = tmp_name(pathname);
+    struct tmp_file *f = name == NULL ? NULL : tmp_find(name);
+    if (f == NULL)
+    {
+        return E_FILE_NOT_IN_CWD;
+    }
+    if (f->opens > 0)
+    {
+        return E_FILE_OPEN;
+    }
+    block_free_chain(f->first_block);
+    f->name[0] = '\0';
+    return E_SUCCESS;
+}
+
+int tmpfopen(char *pathname, file_descriptor *fd)
+{
+    char *name = tmp_name(pathname);
+    struct tmp_file *f = name == NULL ? NULL : tmp_find(name);
+    if (f == NULL)
+    {
+        return E_FILE_NOT_IN_CWD;
+    }
+    int get_stream_status = get_available_stream(fd);
+    if (get_stream_status != E_SUCCESS)
+    {
+        return get_stream_status;
+    }
+    Stream *stream = stream_get(currentPCB, *fd);
+    stream->dev_data = f;
+    stream->position_fgetc = 0;
+    stream->position_sector = f->first_block;
+    stream->position_in_sector = 0;
+    f->opens++;
+    return E_SUCCESS;
+}
+
+int tmpfclose(file_descriptor *fd)
+{
+    struct tmp_file *f = stream_get(currentPCB, *fd)->dev_data;
+    f->opens--;
+    return E_SUCCESS;
+}
+
+int tmpfputc(file_descriptor *fd, char *bufp, int buflen)
+{
+    struct tmp_file *f = stream_get(currentPCB, *fd)->dev_data;
+    uint32_t len = strnlen(bufp, buflen);
+    uint32_t tail_room = f->size % TMP_BLOCK_SIZE == 0 ? 0 : TMP_BLOCK_SIZE - f->size % TMP_BLOCK_SIZE;
+    if (len > tail_room && (len - tail_room + TMP_BLOCK_SIZE - 1) / TMP_BLOCK_SIZE > free_count)
+    {
+        return E_NO_FREE_CLUSTER;
+    }
+    while (len > 0)
+    {
+        uint32_t offset = f->size % TMP_BLOCK_SIZE;
+        if (offset == 0)
+        {
+            uint32_t block = block_alloc();
+            if (f->last_block == TMP_NO_BLOCK)
+            {
+                f->first_block = block;
+            }
+            else
+            {
+                next_block[f->last_block] = block;
+            }
+            f->last_block = block;
+        }
+        uint32_t n = TMP_BLOCK_SIZE - offset;
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(&blocks[f->last_block * TMP_BLOCK_SIZE + offset], bufp, n);
+        f->size += n;
+        bufp += n;
+        len -= n;
+    }
+    return E_SUCCESS;
+}
+
+int tmpfgetc(file_descriptor fd, char *bufp, int buflen, int *charsreadp)
+{
+    Stream *stream = stream_get(currentPCB, fd);
+    struct tmp_file *f = stream->dev_data;
+    if (stream->position_fgetc >= f->size)
+    {
+        *charsreadp = 0;
+        return E_EOF;
+    }
+    // The file may have been empty when it was opened
+    if (stream->position_sector == TMP_NO_BLOCK)
+    {
+        stream->position_sector = f->first_block;
+    }
+    uint32_t n = 0;
+    while (n < buflen && stream->position_fgetc < f->size)
+    {
+        if (stream->position_in_sector == TMP_BLOCK_SIZE)
+        {
+            stream->position_sector = next_block[stream->position_sector];
+            stream->position_in_sector = 0;
+        }
+        uint32_t chunk = TMP_BLOCK_SIZE - stream->position_in_sector;
+        if (chunk > buflen - n)
+        {
+            chunk = buflen - n;
+        }
+        if (chunk > f->size - stream->position_fgetc)
+        {
+            chunk = f->size - stream->position_fgetc;
+        }
+        memcpy(&bufp[n], &blocks[stream->position_sector * TMP_BLOCK_SIZE + stream->position_in_sector], chunk);
+        stream->position_in_sector += chunk;
+        stream->position_fgetc += chunk;
+        n += chunk;
+    }
+    *charsreadp = n;
+    return E_SUCCESS;
+}
+
+Device TMP = {
+    .fgetc = tmpfgetc,
+    .fputc = tmpfputc,
+    .fopen = tmpfopen,
+    .fdelete = tmpfdelete,
+    .fclose = tmpfclose,
+    .fcreate = tmpfcreate,
+    .fflush = NULL,
+};
+
+int initTMP(uint32_t block_count)
+{
+    uint32_t block_bytes = TMP_BLOCK_SIZE + sizeof(uint32_t);
+    if (block_count == 0 || block_count > UINT32_MAX / block_bytes)
+    {
+        return E_MALLOC;
+    }
+    blocks = myMalloc(block_count * block_bytes);
+    if (blocks == NULL)
+    {
+        return E_MALLOC;
+    }
+    next_block = (uint32_t *)(blocks + block_count * TMP_BLOCK_SIZE);
+    free_head = TMP_NO_BLOCK;
+    free_count = 0;
+    for (uint32_t block = block_count; block > 0; block--)
+    {
+        next_block[block - 1] = free_head;
+        free_head = block - 1;
+        free_count++;
+    }
+    for (int i = 0; i < TMP_MAX_FILES; i++)
+    {
+        files[i].name[0] = '\0';
+    }
+    return dev_register(TMP_PATH_PREFIX, &TMP, DEV_PREFIX);
+}
+
+// Write one file to the card. Card writes are NUL terminated, so go a
+// block at a time through a buffer with room for the terminator.
+static int sync_file(struct tmp_file *f)
+{
+    char path[TMP_NAME_MAX + 2] = "/";
+    strcat(path, f->name);
+    myfdelete(path);
+    int status = myfcreate(path);
+    if (status != E_SUCCESS)
+    {
+        return status;
+    }
+    file_descriptor fd;
+    status = myfopen(path, &fd);
+    if (status != E_SUCCESS)
+    {
+        return status;
+    }
+    char buf[TMP_BLOCK_SIZE + 1];
+    uint32_t remaining = f->size;
+    for (uint32_t block = f->first_block; remaining > 0 && status == E_SUCCESS; block = next_block[block])
+    {
+        uint32_t n = remaining < TMP_BLOCK_SIZE ? remaining : TMP_BLOCK_SIZE;
+        memcpy(buf, &blocks[block * TMP_BLOCK_SIZE], n);
+        buf[n] = '\0';
+        status = myfputc(&fd, buf, n + 1);
+        remaining -= n;
+    }
+    int close_status = myfclose(&fd);
+    return status != E_SUCCESS ? status : close_status;
+}
+
+// Returns 1 if name is an uppercase 8.3 name the card will accept.
+static int card_name_valid(char *name)
+{
+    char *dot = strchr(name, '.');
+    size_t base = dot == NULL ? strlen(name) : (size_t)(dot - name);
+    if (base == 0 || base > 8 || (dot != NULL && (strlen(dot + 1) > 3 || strchr(dot + 1, '.') != NULL)))
+    {
+        return 0;
+    }
+    for (char *c = name; *c != '\0'; c++)
+    {
+        if (*c >= 'a' && *c <= 'z')
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int tmp_sync(void)
+{
+    for (int i = 0; i < TMP_MAX_FILES; i++)
+    {
+        if (files[i].name[0] == '\0' || !card_name_valid(files[i].name))
+        {
+            continue;
+        }
+        int status = sync_file(&files[i]);
+        if (status != E_SUCCESS)
+        {
+            return status;
+        }
+    }
+    return E_SUCCESS;
+}
@@ -0,0 +1,42 @@
+/**
+ * myTMPdriver.h
+ * A RAM disk in SDRAM mounted at /tmp
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _MYTMPDRIVER_H
+#define _MYTMPDRIVER_H
+
+#include "devinio.h"
+
+#define TMP_PATH_PREFIX "/tmp/"
+
+/**
+ * The RAM disk is a number of blocks of TMP_BLOCK_SIZE bytes, chosen at boot
+ * (TMP_DEFAULT_BLOCKS unless the board wants otherwise) and allocated from
+ * SDRAM, holding up to TMP_MAX_FILES files with names of up to TMP_NAME_MAX
+ * characters.
+ */
+#define TMP_BLOCK_SIZE 512
+#define TMP_DEFAULT_BLOCKS 8192
+#define TMP_MAX_FILES 32
+#define TMP_NAME_MAX 14
+
+extern Device TMP;
+
+/**
+ * Allocate a RAM disk of block_count blocks and register /tmp/.
+ * Returns: E_SUCCESS, or E_MALLOC if there is no room for the disk
+ */
+int initTMP(uint32_t block_count);
+
+/**
+ * Copy every file in /tmp to the root directory of the card under the same
+ * name, replacing any file already there. Card file names must be 8.3 and
+ * uppercase, so files whose names are not are skipped.
+ * Returns: E_SUCCESS, or the first error writing a file to the card
+ */
+int tmp_sync(void);
+
+#endif /* ifndef _MYTMPDRIVER_H */
@@ -8,6 +8,7 @@
 #include "myUARTdriver.h"
 #include "my-malloc.h"
 #include "utils.h"
+#include "devinutils.h"
 #include <string.h>
 
 Device UART;
@@ -17,7 +18,7 @@ Device UART;
 int uartfgetc(file_descriptor descr, char *bufp, int buflen, int *charsreadp)
 {
     char *uart_channel;
-    sprintf(uart_channel, "UART%d_BASE_PTR", uartGetline((currentPCB->streams)[*fd].device_id);
+    sprintf(uart_channel, "UART%d_BASE_PTR", uartGetline(stream_get(currentPCB, *fd)->device_id);
     // This function will NULL terminate the string placed in bufp
     uartGetline(*uart_channel, bufp, buflen);
     return E_SUCCESS;
@@ -26,7 +27,7 @@ int uartfgetc(file_descriptor descr, char *bufp, int buflen, int *charsreadp)
 int uartfputc(file_descriptor *fd, char *bufp, int buflen)
 {
     char *uart_channel;
-    sprintf(uart_channel, "UART%d_BASE_PTR", uartGetline((currentPCB->streams)[*fd].device_id);
+    sprintf(uart_channel, "UART%d_BASE_PTR", uartGetline(stream_get(currentPCB, *fd)->device_id);
     uartPutsNL(*uart_channel, bufp);
     return E_SUCCESS;
 }
@@ -44,7 +45,7 @@ int uartfclose(file_descriptor *fd)
 int uartfopen(char *pathname, file_descriptor *fd)
 {
     // The number of the uart channel will always be the 9th character in a UART device path
-    (currentPCB->streams)[*fd].device_id = *pathname[9];
+    stream_get(currentPCB, *fd)->device_id = *pathname[9];
     return E_SUCCESS;
 }
 
@@ -67,6 +68,7 @@ int inituart(void) {
     UART.fopen = uartfopen;
     UART.fdelete = uartfdelete;
     UART.fcreate = uartfcreate;
+    dev_register("/dev/uart", &UART, DEV_EXACT);
     return E_SUCCESS;
 }
 
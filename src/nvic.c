@@ -0,0 +1,26 @@
+/**
+ * nvic.c
+ * Enabling and prioritizing peripheral interrupts in the NVIC
+ *
+ * Author: James Nicholson
+ */
+
+#include "nvic.h"
+#include "derivative.h"
+
+/* The K70 implements 4 priority bits in the high-order nibble of each
+ * NVIC_IPR byte (See K70 Sub-Family Reference Manual, Rev. 4, Section
+ * 3.2.2.1). */
+#define NVIC_PRIORITY_SHIFT 4
+
+void nvic_enable_irq(int irq, int priority)
+{
+    NVIC_IP_REG(NVIC_BASE_PTR, irq) = priority << NVIC_PRIORITY_SHIFT;
+    NVIC_ICPR_REG(NVIC_BASE_PTR, irq / 32) = 1 << (irq % 32);
+    NVIC_ISER_REG(NVIC_BASE_PTR, irq / 32) = 1 << (irq % 32);
+}
+
+void nvic_disable_irq(int irq)
+{
+    NVIC_ICER_REG(NVIC_BASE_PTR, irq / 32) = 1 << (irq % 32);
+}
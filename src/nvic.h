@@ -0,0 +1,22 @@
+/**
+ * nvic.h
+ * Enabling and prioritizing peripheral interrupts in the NVIC
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _NVIC_H
+#define _NVIC_H
+
+/**
+ * Set the priority (0 to 15, 0 is highest) of interrupt irq, clear any
+ * stale pending request and enable it. irq is the vector number minus 16.
+ */
+void nvic_enable_irq(int irq, int priority);
+
+/**
+ * Disable interrupt irq.
+ */
+void nvic_disable_irq(int irq);
+
+#endif /* ifndef _NVIC_H */
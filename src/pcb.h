@@ -1,14 +1,64 @@
 #ifndef _MYPCB_H
 #define _MYPCB_H
 
+#include <stdint.h>
+#include <stddef.h>
 #include "devinio.h"
+#include "timer.h"
+
+/**
+ * A process's streams are kept in up to STREAM_TABLES tables of
+ * STREAMS_PER_TABLE. The first is part of the pcb; the others are allocated
+ * the first time the process needs them.
+ */
+#define STREAMS_PER_TABLE 32
+#define STREAM_TABLES 8
+#define MAX_STREAMS (STREAMS_PER_TABLE * STREAM_TABLES)
+
+enum proc_state
+{
+    PROC_RUNNING,
+    PROC_READY,
+    PROC_BLOCKED,
+    PROC_EXITED
+};
 
 struct pcb
 {
     int pid;
-    Stream streams[32];
+    enum proc_state state;
+    uint32_t *sp; // saved process stack pointer while the process is not running
+    void *stack; // lowest address of the process stack, NULL for the boot context
+    uint32_t stack_size;
+    uint32_t ticks; // SysTick ticks spent running
+    struct timer sleep_timer; // wakes the process from proc_sleep
+    struct timer alarm_timer; // drives the process's alarm
+    uint32_t alarm_period; // ticks between alarms, 0 for a one-shot alarm
+    uint32_t alarm_count; // alarms since the process last collected them
+    uint8_t alarm_waiting; // whether the process is blocked until the next alarm
+    struct timer poll_timer; // ends the process's wait in poll
+    uint8_t poll_timed_out; // whether poll_timer has gone off during the current poll
+    struct pcb *next; // link in the run queue or a wait queue
+    uint32_t streams_open[STREAM_TABLES]; // bit n of word t is set if fd t*32+n is open
+    uint32_t tables_full; // bit t is set if every fd in table t is open
+    Stream *stream_tables[STREAM_TABLES]; // NULL until a table is needed
+    Stream streams[STREAMS_PER_TABLE]; // the first table
 };
 
 extern struct pcb *currentPCB;
 
-#endif /* ifndef _MYPCB_H */
\ No newline at end of file
+/**
+ * Returns: pcb's Stream for fd, or NULL if fd is beyond its tables. Whether
+ * the stream is open is up to the caller to check.
+ */
+static inline Stream *stream_get(struct pcb *pcb, file_descriptor fd)
+{
+    if (fd >= MAX_STREAMS)
+    {
+        return NULL;
+    }
+    Stream *table = pcb->stream_tables[fd / STREAMS_PER_TABLE];
+    return table == NULL ? NULL : &table[fd % STREAMS_PER_TABLE];
+}
+
+#endif /* ifndef _MYPCB_H */
@@ -0,0 +1,431 @@
+/**
+ * proc.c
+ * Process creation and preemptive context switching
+ *
+ * Author: James Nicholson
+ */
+
+#include "proc.h"
+#include <stddef.h>
+#include "derivative.h"
+#include "my-malloc.h"
+#include "utils.h"
+#include "breakpoint.h"
+#include "mySTDSTRMdriver.h"
+#include "devinutils.h"
+#include "clock.h"
+#include "waitq.h"
+#include "svc.h"
+#include "aio.h"
+
+/**
+ * Implementation Notes
+ *
+ * Every process runs in thread mode on its own process stack (PSP); handlers
+ * keep running on the main stack. When a process is switched out, PendSV
+ * pushes r4-r11 and its EXC_RETURN value below the frame the hardware already
+ * stacked on exception entry (plus s16-s31 if the process had used the FPU),
+ * and stores the resulting stack pointer in pcb->sp. Switching in does the
+ * reverse, so a new process only needs a fake frame built by proc_create.
+ *
+ * SysTick only decides whether a switch is due; the switch itself always
+ * happens in PendSV, which runs at the lowest priority. That means a process
+ * is never switched out while an SVC or device handler is part way through,
+ * so kernel code called through an SVC is not preempted.
+ *
+ * Sleeps and alarms are timers on kernel_timers, which SysTick advances, so
+ * a tick costs the same however many processes are sleeping.
+ */
+
+#define XPSR_THUMB 0x01000000
+#define EXC_RETURN_THREAD_PSP 0xFFFFFFFD
+#define SVC_EXCEPTION_NUMBER 11
+
+struct scheduler kernel_sched;
+struct timer_wheel kernel_timers;
+
+/**
+ * Every process waiting in poll sleeps here, whichever streams it is
+ * waiting on, and is woken to check them all again by proc_poll_wake.
+ */
+static struct wait_queue poll_wq = WAIT_QUEUE_INIT;
+
+static int next_pid = 1;
+static int started = 0;
+
+/**
+ * The boot context's registers are saved here by the first PendSV and never
+ * restored. It only needs to hold r4-r11, EXC_RETURN and s16-s31.
+ */
+static uint32_t boot_save_area[32];
+
+uint32_t proc_irq_save(void)
+{
+    uint32_t primask;
+    __asm volatile("mrs %0, primask\n\tcpsid i" : "=r"(primask) : : "memory");
+    return primask;
+}
+
+void proc_irq_restore(uint32_t primask)
+{
+    __asm volatile("msr primask, %0" : : "r"(primask) : "memory");
+}
+
+/**
+ * basepri_max only ever raises the mask, so a lock taken inside another, or
+ * inside a handler that already runs above SysTick, leaves it unchanged.
+ */
+uint32_t proc_sched_lock(void)
+{
+    uint32_t basepri;
+    __asm volatile("mrs %0, basepri\n\tmsr basepri_max, %1"
+                   : "=&r"(basepri) : "r"(SYSTICK_PRIORITY << 4) : "memory");
+    return basepri;
+}
+
+void proc_sched_unlock(uint32_t basepri)
+{
+    __asm volatile("msr basepri, %0" : : "r"(basepri) : "memory");
+}
+
+void proc_yield(void)
+{
+    SCB_ICSR = SCB_ICSR_PENDSVSET_MASK;
+}
+
+/**
+ * Called when a process returns from its entry point. The stack and pcb are
+ * not reclaimed, but its timers are taken off the wheel so none of them can
+ * fire for, or wake, a process that has exited, and its async I/O requests
+ * are given up.
+ */
+static void proc_exit(int status)
+{
+    uint32_t primask = proc_irq_save();
+    timer_cancel(&currentPCB->sleep_timer);
+    timer_cancel(&currentPCB->alarm_timer);
+    timer_cancel(&currentPCB->poll_timer);
+    aio_exit();
+    currentPCB->state = PROC_EXITED;
+    proc_irq_restore(primask);
+    proc_yield();
+    while (1)
+    {
+    }
+}
+
+int proc_started(void)
+{
+    return started;
+}
+
+int proc_in_svc(void)
+{
+    uint32_t ipsr;
+    __asm volatile("mrs %0, ipsr" : "=r"(ipsr));
+    return started && ipsr == SVC_EXCEPTION_NUMBER;
+}
+
+int proc_can_block(void)
+{
+    uint32_t ipsr;
+    __asm volatile("mrs %0, ipsr" : "=r"(ipsr));
+    return started && ipsr == 0;
+}
+
+// Tick on which a sleep of ms milliseconds starting now has surely elapsed.
+static uint32_t ms_to_expiry(uint32_t ms)
+{
+    // Add one because the current tick is already partly over.
+    return kernel_timers.now + (ms * SCHED_TICK_HZ + 999) / 1000 + 1;
+}
+
+static void sleep_expired(struct timer *t)
+{
+    sched_ready(&kernel_sched, t->arg);
+}
+
+static void alarm_expired(struct timer *t)
+{
+    struct pcb *p = t->arg;
+    p->alarm_count++;
+    if (p->alarm_period != 0)
+    {
+        timer_add(&kernel_timers, t, t->expires + p->alarm_period);
+    }
+    if (p->alarm_waiting)
+    {
+        p->alarm_waiting = 0;
+        sched_ready(&kernel_sched, p);
+    }
+}
+
+static void poll_expired(struct timer *t)
+{
+    ((struct pcb *)t->arg)->poll_timed_out = 1;
+    waitq_wake_all(&poll_wq);
+}
+
+void proc_init_timers(struct pcb *pcb)
+{
+    timer_init(&pcb->sleep_timer, sleep_expired, pcb);
+    timer_init(&pcb->alarm_timer, alarm_expired, pcb);
+    pcb->alarm_period = 0;
+    pcb->alarm_count = 0;
+    pcb->alarm_waiting = 0;
+    timer_init(&pcb->poll_timer, poll_expired, pcb);
+    pcb->poll_timed_out = 0;
+}
+
+void proc_sleep_svc(uint32_t ms)
+{
+    if (!started)
+    {
+        clock_delay_us(ms * 1000);
+        return;
+    }
+    uint32_t primask = proc_irq_save();
+    currentPCB->state = PROC_BLOCKED;
+    timer_add(&kernel_timers, &currentPCB->sleep_timer, ms_to_expiry(ms));
+    proc_yield();
+    proc_irq_restore(primask);
+}
+
+void proc_sleep(uint32_t ms)
+{
+    if (!proc_can_block())
+    {
+        clock_delay_us(ms * 1000);
+        return;
+    }
+    proc_sleep_svc(ms);
+}
+
+void proc_alarm(uint32_t ms, uint32_t period_ms)
+{
+    uint32_t primask = proc_irq_save();
+    timer_cancel(&currentPCB->alarm_timer);
+    currentPCB->alarm_count = 0;
+    currentPCB->alarm_period = (period_ms * SCHED_TICK_HZ + 999) / 1000;
+    if (ms != 0)
+    {
+        timer_add(&kernel_timers, &currentPCB->alarm_timer, ms_to_expiry(ms));
+    }
+    proc_irq_restore(primask);
+}
+
+int proc_alarm_wait(void)
+{
+    uint32_t primask = proc_irq_save();
+    int block = currentPCB->alarm_count == 0 && timer_pending(&currentPCB->alarm_timer) && started;
+    if (block)
+    {
+        currentPCB->alarm_waiting = 1;
+        currentPCB->state = PROC_BLOCKED;
+        proc_yield();
+    }
+    proc_irq_restore(primask);
+    return block;
+}
+
+uint32_t proc_alarm_collect(void)
+{
+    uint32_t primask = proc_irq_save();
+    uint32_t count = currentPCB->alarm_count;
+    currentPCB->alarm_count = 0;
+    proc_irq_restore(primask);
+    return count;
+}
+
+void proc_poll_wake(void)
+{
+    waitq_wake_all(&poll_wq);
+}
+
+int proc_poll_block(int32_t timeout_ms)
+{
+    if (!started || timeout_ms == 0 || currentPCB->poll_timed_out)
+    {
+        return 0;
+    }
+    // A poll being retried after a wakeup keeps its original deadline.
+    if (timeout_ms > 0 && !timer_pending(&currentPCB->poll_timer))
+    {
+        timer_add(&kernel_timers, &currentPCB->poll_timer, ms_to_expiry(timeout_ms));
+    }
+    waitq_block(&poll_wq);
+    return 1;
+}
+
+void proc_poll_done(void)
+{
+    timer_cancel(&currentPCB->poll_timer);
+    currentPCB->poll_timed_out = 0;
+}
+
+/**
+ * Runs when no other process is ready. WFI stops the core clock until the
+ * next interrupt, which is what makes a blocked process wake up again.
+ */
+static int idle(int argc, char **argv)
+{
+    while (1)
+    {
+#if MALLOC_DEBUG
+        uint32_t checked;
+        void *bad_region;
+        if (heapCheck(IDLE_HEAPCHECK_BLOCKS, &checked, &bad_region) == E_HEAP_CORRUPT)
+        {
+            __BKPT();
+        }
+#endif
+        __asm volatile("wfi");
+    }
+    return 0;
+}
+
+static int new_pcb(proc_entry entry, int argc, char **argv, struct pcb **pcbp)
+{
+    struct pcb *pcb = myMalloc(sizeof(struct pcb));
+    if (pcb == NULL)
+    {
+        return E_MALLOC;
+    }
+    void *stack = myMalloc(PROC_STACK_SIZE);
+    if (stack == NULL)
+    {
+        myFree(pcb);
+        return E_MALLOC;
+    }
+    pcb->pid = next_pid++;
+    pcb->stack = stack;
+    pcb->stack_size = PROC_STACK_SIZE;
+    pcb->ticks = 0;
+    pcb->next = NULL;
+    proc_init_timers(pcb);
+    streams_init(pcb);
+    stdstrm_attach(pcb);
+    // Build the frame PendSV expects to find: the hardware exception frame
+    // on top, with the registers PendSV saves itself below it.
+    uint32_t *sp = (uint32_t *)(((uint32_t)stack + PROC_STACK_SIZE) & ~7u);
+    *--sp = XPSR_THUMB;
+    // Clear the Thumb bit of the address; the T bit comes from the xPSR.
+    *--sp = (uint32_t)entry & ~1u; // pc
+    *--sp = (uint32_t)proc_exit; // lr
+    *--sp = 0; // r12
+    *--sp = 0; // r3
+    *--sp = 0; // r2
+    *--sp = (uint32_t)argv; // r1
+    *--sp = (uint32_t)argc; // r0
+    *--sp = EXC_RETURN_THREAD_PSP;
+    for (int i = 0; i < 8; i++)
+    {
+        *--sp = 0; // r11 down to r4
+    }
+    pcb->sp = sp;
+    pcb->state = PROC_BLOCKED;
+    *pcbp = pcb;
+    return E_SUCCESS;
+}
+
+int proc_create(proc_entry entry, int argc, char **argv, struct pcb **pcbp)
+{
+    struct pcb *pcb;
+    int status = new_pcb(entry, argc, argv, &pcb);
+    if (status != E_SUCCESS)
+    {
+        return status;
+    }
+    uint32_t primask = proc_irq_save();
+    sched_ready(&kernel_sched, pcb);
+    proc_irq_restore(primask);
+    if (pcbp != NULL)
+    {
+        *pcbp = pcb;
+    }
+    return E_SUCCESS;
+}
+
+int proc_init(void)
+{
+    struct pcb *idle_pcb;
+    int status = new_pcb(idle, 0, NULL, &idle_pcb);
+    if (status != E_SUCCESS)
+    {
+        return status;
+    }
+    sched_init(&kernel_sched, currentPCB, idle_pcb, SCHED_QUANTUM_TICKS);
+    timer_wheel_init(&kernel_timers);
+    return E_SUCCESS;
+}
+
+void proc_start(void)
+{
+    // The boot context never runs again, so nothing else would write out
+    // what it left in its stdout buffer.
+    stdout_flush();
+    uint32_t primask = proc_irq_save();
+    // The boot context is current until the first switch, but it is never
+    // resumed, so make sure it is not put back on the run queue.
+    currentPCB->state = PROC_EXITED;
+    svcInit_SetSVCPriority(SVC_PRIORITY);
+    SCB_SHPR3 = (SCB_SHPR3 & ~(SCB_SHPR3_PRI_14_MASK | SCB_SHPR3_PRI_15_MASK)) |
+        SCB_SHPR3_PRI_14(PENDSV_PRIORITY << 4) | SCB_SHPR3_PRI_15(SYSTICK_PRIORITY << 4);
+    SysTick_RVR = SysTick_RVR_RELOAD(PROC_CORE_CLOCK_HZ / SCHED_TICK_HZ - 1);
+    SysTick_CVR = 0;
+    SysTick_CSR = SysTick_CSR_CLKSOURCE_MASK | SysTick_CSR_TICKINT_MASK | SysTick_CSR_ENABLE_MASK;
+    // PendSV saves whatever is at PSP, so point it somewhere harmless.
+    __asm volatile("msr psp, %0" : : "r"(&boot_save_area[32]));
+    started = 1;
+    proc_yield();
+    proc_irq_restore(primask);
+    while (1)
+    {
+    }
+}
+
+void sysTickHandler(void)
+{
+    uint32_t primask = proc_irq_save();
+    clock_cycles();
+    // Run the timers first so a process they wake is seen by sched_tick.
+    timer_wheel_tick(&kernel_timers);
+    int preempt = sched_tick(&kernel_sched);
+    proc_irq_restore(primask);
+    if (preempt)
+    {
+        proc_yield();
+    }
+}
+
+/**
+ * Called from pendSVHandler with the outgoing process's saved stack pointer.
+ * Returns the saved stack pointer of the process to switch to.
+ */
+uint32_t *procSwitch(uint32_t *sp)
+{
+    uint32_t primask = proc_irq_save();
+    currentPCB->sp = sp;
+    currentPCB = sched_switch(&kernel_sched);
+    sp = currentPCB->sp;
+    proc_irq_restore(primask);
+    return sp;
+}
+
+void __attribute__((naked)) pendSVHandler(void)
+{
+    __asm("\n\
+            mrs		r0, psp\n\
+            tst		lr, #0x10\n\
+            it		eq\n\
+            vstmdbeq	r0!, {s16-s31}\n\
+            stmdb	r0!, {r4-r11, lr}\n\
+            bl		procSwitch\n\
+            ldmia	r0!, {r4-r11, lr}\n\
+            tst		lr, #0x10\n\
+            it		eq\n\
+            vldmiaeq	r0!, {s16-s31}\n\
+            msr		psp, r0\n\
+            bx		lr\n\
+            ");
+}
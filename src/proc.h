@@ -0,0 +1,186 @@
+/**
+ * proc.h
+ * Process creation and preemptive context switching
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _PROC_H
+#define _PROC_H
+
+#include <stdint.h>
+#include "pcb.h"
+#include "sched.h"
+#include "timer.h"
+
+/**
+ * Size in bytes of each process stack. myprintf alone puts an 8 KB buffer on
+ * the stack, so this must stay comfortably above that.
+ */
+#define PROC_STACK_SIZE 16384
+
+/**
+ * Core clock frequency, set up by mcgInit.
+ */
+#define PROC_CORE_CLOCK_HZ 120000000
+
+/**
+ * SysTick interrupts per second and the number of ticks in a time slice.
+ */
+#define SCHED_TICK_HZ 1000
+#define SCHED_QUANTUM_TICKS 10
+
+/**
+ * Number of heap regions the idle process verifies each time it wakes when
+ * the allocator is built with MALLOC_DEBUG.
+ */
+#define IDLE_HEAPCHECK_BLOCKS 16
+
+/**
+ * Exception priorities. PendSV must be the lowest priority in the system so
+ * that a context switch never happens in the middle of another handler.
+ * SVCs run below every device interrupt, so a long one (a FAT32 write, say)
+ * doesn't hold off the UART receiver, but above SysTick, so the scheduler
+ * never runs in the middle of one.
+ */
+#define SVC_PRIORITY 12
+#define SYSTICK_PRIORITY 14
+#define PENDSV_PRIORITY 15
+
+/**
+ * The scheduler used by the SysTick and PendSV handlers.
+ */
+extern struct scheduler kernel_sched;
+
+/**
+ * The timers driven by SysTick. Its ticks are SCHED_TICK_HZ ticks.
+ */
+extern struct timer_wheel kernel_timers;
+
+/**
+ * Signature of a process entry point. A process that returns from its entry
+ * point exits.
+ */
+typedef int (*proc_entry)(int argc, char **argv);
+
+/**
+ * Set up the scheduler with the boot context as the running process and
+ * create the idle process.
+ * Returns: E_SUCCESS, or E_MALLOC if there is no memory for the idle process
+ */
+int proc_init(void);
+
+/**
+ * Create a process that will start at entry(argc, argv) the next time it is
+ * scheduled, and place it on the run queue.
+ * Returns: E_SUCCESS, or E_MALLOC if there is no memory for its pcb or stack
+ */
+int proc_create(proc_entry entry, int argc, char **argv, struct pcb **pcbp);
+
+/**
+ * Start the SysTick time slice and switch to the first process on the run
+ * queue. The calling (boot) context is abandoned, so this never returns.
+ */
+void proc_start(void);
+
+/**
+ * Ask for a context switch as soon as no other handler is active.
+ */
+void proc_yield(void);
+
+/**
+ * Returns: 1 if the caller may sleep, i.e. the scheduler is running and the
+ * caller is a process in thread mode rather than a handler, 0 otherwise
+ */
+int proc_can_block(void);
+
+/**
+ * Returns: 1 once proc_start has handed the CPU to the scheduler, 0 before
+ */
+int proc_started(void);
+
+/**
+ * Set up the sleep and alarm timers of a new pcb.
+ */
+void proc_init_timers(struct pcb *pcb);
+
+/**
+ * Returns: 1 if the caller is an SVC handler running on behalf of a process
+ * that may be put to sleep, 0 otherwise
+ */
+int proc_in_svc(void);
+
+/**
+ * Take the running process off the run queue for at least ms milliseconds.
+ * Where the caller cannot block this falls back to clock_delay_us.
+ */
+void proc_sleep(uint32_t ms);
+
+/**
+ * proc_sleep for SVC handlers: the calling process stops once the handler
+ * returns, and resumes after the SVC. Before the scheduler starts this
+ * busy-waits instead.
+ */
+void proc_sleep_svc(uint32_t ms);
+
+/**
+ * Arm the running process's alarm to go off in ms milliseconds and then
+ * every period_ms milliseconds (once only if period_ms is 0). An ms of 0
+ * disarms it. Alarms not yet collected are discarded.
+ */
+void proc_alarm(uint32_t ms, uint32_t period_ms);
+
+/**
+ * Called from an SVC handler on behalf of a process waiting for its alarm.
+ * Returns: 1 if the process has been put to sleep until the alarm goes off
+ * and must retry, 0 if alarms are waiting to be collected or none is armed
+ */
+int proc_alarm_wait(void);
+
+/**
+ * Returns: the number of times the running process's alarm has gone off
+ * since it was last called
+ */
+uint32_t proc_alarm_collect(void);
+
+/**
+ * Wake every process waiting in poll so it checks its streams again.
+ * Devices call this whenever one of their streams may have become ready.
+ * Safe to call from an interrupt handler.
+ */
+void proc_poll_wake(void);
+
+/**
+ * Called with interrupts masked from the poll SVC handler when none of the
+ * caller's streams is ready. A timeout_ms of 0 never waits and a negative
+ * one waits with no time limit.
+ * Returns: 1 if the process has been put to sleep until proc_poll_wake or
+ * its timeout and must retry, 0 if the timeout has expired
+ */
+int proc_poll_block(int32_t timeout_ms);
+
+/**
+ * Called by the poll SVC handler before it returns, to stop the running
+ * process's poll timeout.
+ */
+void proc_poll_done(void);
+
+/**
+ * Mask and restore interrupts around updates to state shared with handlers.
+ */
+uint32_t proc_irq_save(void);
+void proc_irq_restore(uint32_t primask);
+
+/**
+ * Hold off SysTick and PendSV, and with them any process switch, while
+ * leaving device interrupts enabled. Only for state that processes and SVC
+ * handlers share and interrupt handlers never touch.
+ * Returns: the previous BASEPRI, to be passed to proc_sched_unlock
+ */
+uint32_t proc_sched_lock(void);
+void proc_sched_unlock(uint32_t basepri);
+
+void sysTickHandler(void);
+void pendSVHandler(void);
+
+#endif /* ifndef _PROC_H */
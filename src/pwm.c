@@ -0,0 +1,42 @@
+/**
+ * pwm.c
+ * PWM outputs on FlexTimer 2
+ *
+ * Author: James Nicholson
+ */
+
+#include "pwm.h"
+#include "derivative.h"
+
+/**
+ * Implementation Notes
+ *
+ * The channels run in edge-aligned mode with low-true pulses (MSB and ELSA
+ * set), so each output goes low when the counter reloads and high when it
+ * reaches CnV. CnV is therefore the number of counts the LED is lit for: 0
+ * keeps it off and PWM_PERIOD_COUNTS keeps it on. Once running, the timer
+ * needs no attention from the CPU.
+ */
+
+void pwm_init(void)
+{
+    SIM_SCGC3 |= SIM_SCGC3_FTM2_MASK;
+    FTM_MODE_REG(FTM2_BASE_PTR) = FTM_MODE_WPDIS_MASK;
+    FTM_SC_REG(FTM2_BASE_PTR) = 0;
+    FTM_CNTIN_REG(FTM2_BASE_PTR) = 0;
+    FTM_CNT_REG(FTM2_BASE_PTR) = 0;
+    FTM_MOD_REG(FTM2_BASE_PTR) = PWM_PERIOD_COUNTS - 1;
+    FTM_CnSC_REG(FTM2_BASE_PTR, PWM_CHANNEL_BLUE) = FTM_CnSC_MSB_MASK | FTM_CnSC_ELSA_MASK;
+    FTM_CnSC_REG(FTM2_BASE_PTR, PWM_CHANNEL_ORANGE) = FTM_CnSC_MSB_MASK | FTM_CnSC_ELSA_MASK;
+    FTM_CnV_REG(FTM2_BASE_PTR, PWM_CHANNEL_BLUE) = 0;
+    FTM_CnV_REG(FTM2_BASE_PTR, PWM_CHANNEL_ORANGE) = 0;
+    // Count the bus clock with no prescaling
+    FTM_SC_REG(FTM2_BASE_PTR) = FTM_SC_CLKS(1) | FTM_SC_PS(0);
+    PORTA_PCR10 = PORT_PCR_MUX(PWM_PORT_PCR_MUX_FTM);
+    PORTA_PCR11 = PORT_PCR_MUX(PWM_PORT_PCR_MUX_FTM);
+}
+
+void pwm_set(int channel, uint32_t low_counts)
+{
+    FTM_CnV_REG(FTM2_BASE_PTR, channel) = low_counts;
+}
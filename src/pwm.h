@@ -0,0 +1,42 @@
+/**
+ * pwm.h
+ * PWM outputs on FlexTimer 2
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _PWM_H
+#define _PWM_H
+
+#include <stdint.h>
+
+/**
+ * FTM2 counts the 60 MHz bus clock up to PWM_PERIOD_COUNTS, which gives a
+ * 1 kHz PWM frequency, fast enough not to flicker.
+ */
+#define PWM_BUS_CLOCK_HZ 60000000
+#define PWM_FREQUENCY_HZ 1000
+#define PWM_PERIOD_COUNTS (PWM_BUS_CLOCK_HZ / PWM_FREQUENCY_HZ)
+
+/**
+ * FTM2 channels and the PORTA pins they are routed to (alternative 3). The
+ * LEDs are lit when their pin is low.
+ */
+#define PWM_CHANNEL_BLUE 0
+#define PWM_CHANNEL_ORANGE 1
+#define PWM_PORT_PCR_MUX_FTM 3
+
+/**
+ * Start FTM2 and hand the blue and orange LED pins over to it, with both
+ * LEDs off. ledInitAll must have been called first.
+ */
+void pwm_init(void);
+
+/**
+ * Hold channel's output low (LED lit) for low_counts of every
+ * PWM_PERIOD_COUNTS. The new value takes effect at the end of the current
+ * period.
+ */
+void pwm_set(int channel, uint32_t low_counts);
+
+#endif /* ifndef _PWM_H */
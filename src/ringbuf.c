@@ -0,0 +1,108 @@
+/**
+ * ringbuf.c
+ * Lock-free single producer, single consumer byte ring buffer
+ *
+ * Author: James Nicholson
+ */
+
+#include "ringbuf.h"
+#include <string.h>
+
+/**
+ * Implementation Notes
+ *
+ * The barrier between touching data and publishing the new head (or tail)
+ * keeps the compiler, and the core's write buffer, from letting the other
+ * side see the index move before the bytes it covers are there.
+ */
+
+#define RINGBUF_BARRIER() __sync_synchronize()
+
+void ringbuf_init(struct ringbuf *rb, uint8_t *storage, uint32_t size)
+{
+    rb->head = 0;
+    rb->tail = 0;
+    rb->mask = size - 1;
+    rb->data = storage;
+}
+
+uint32_t ringbuf_count(const struct ringbuf *rb)
+{
+    return rb->head - rb->tail;
+}
+
+uint32_t ringbuf_space(const struct ringbuf *rb)
+{
+    return rb->mask + 1 - (rb->head - rb->tail);
+}
+
+int ringbuf_put(struct ringbuf *rb, uint8_t c)
+{
+    uint32_t head = rb->head;
+    if (head - rb->tail > rb->mask)
+    {
+        return 0;
+    }
+    rb->data[head & rb->mask] = c;
+    RINGBUF_BARRIER();
+    rb->head = head + 1;
+    return 1;
+}
+
+int ringbuf_get(struct ringbuf *rb, uint8_t *c)
+{
+    uint32_t tail = rb->tail;
+    if (rb->head == tail)
+    {
+        return 0;
+    }
+    RINGBUF_BARRIER();
+    *c = rb->data[tail & rb->mask];
+    RINGBUF_BARRIER();
+    rb->tail = tail + 1;
+    return 1;
+}
+
+uint32_t ringbuf_write(struct ringbuf *rb, const uint8_t *buf, uint32_t len)
+{
+    uint32_t head = rb->head;
+    uint32_t space = rb->mask + 1 - (head - rb->tail);
+    if (len > space)
+    {
+        len = space;
+    }
+    // Copy in at most two pieces: up to the end of storage, then from the start.
+    uint32_t offset = head & rb->mask;
+    uint32_t first = rb->mask + 1 - offset;
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(&rb->data[offset], buf, first);
+    memcpy(&rb->data[0], buf + first, len - first);
+    RINGBUF_BARRIER();
+    rb->head = head + len;
+    return len;
+}
+
+uint32_t ringbuf_read(struct ringbuf *rb, uint8_t *buf, uint32_t len)
+{
+    uint32_t tail = rb->tail;
+    uint32_t count = rb->head - tail;
+    if (len > count)
+    {
+        len = count;
+    }
+    RINGBUF_BARRIER();
+    uint32_t offset = tail & rb->mask;
+    uint32_t first = rb->mask + 1 - offset;
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(buf, &rb->data[offset], first);
+    memcpy(buf + first, &rb->data[0], len - first);
+    RINGBUF_BARRIER();
+    rb->tail = tail + len;
+    return len;
+}
@@ -0,0 +1,69 @@
+/**
+ * ringbuf.h
+ * Lock-free single producer, single consumer byte ring buffer
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _RINGBUF_H
+#define _RINGBUF_H
+
+#include <stdint.h>
+
+/**
+ * head and tail count bytes put and taken since ringbuf_init and are only
+ * reduced modulo the size when indexing data, so the buffer can use every
+ * byte of its storage and full and empty are never ambiguous. Only the
+ * producer writes head and only the consumer writes tail, so one side may
+ * run in an interrupt handler while the other runs in a process without
+ * any locking. More than one producer (or consumer) must serialize among
+ * themselves.
+ */
+struct ringbuf
+{
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t mask; // size - 1
+    uint8_t *data;
+};
+
+/**
+ * Initialize rb to use size bytes at storage. size must be a power of two.
+ */
+void ringbuf_init(struct ringbuf *rb, uint8_t *storage, uint32_t size);
+
+/**
+ * Returns: the number of bytes waiting to be read
+ */
+uint32_t ringbuf_count(const struct ringbuf *rb);
+
+/**
+ * Returns: the number of bytes that can be put before the buffer is full
+ */
+uint32_t ringbuf_space(const struct ringbuf *rb);
+
+/**
+ * Append c.
+ * Returns: 1 on success, 0 if the buffer is full
+ */
+int ringbuf_put(struct ringbuf *rb, uint8_t c);
+
+/**
+ * Remove the oldest byte into *c.
+ * Returns: 1 on success, 0 if the buffer is empty
+ */
+int ringbuf_get(struct ringbuf *rb, uint8_t *c);
+
+/**
+ * Append as many of the len bytes at buf as fit.
+ * Returns: the number of bytes appended
+ */
+uint32_t ringbuf_write(struct ringbuf *rb, const uint8_t *buf, uint32_t len);
+
+/**
+ * Remove up to len bytes into buf.
+ * Returns: the number of bytes removed
+ */
+uint32_t ringbuf_read(struct ringbuf *rb, uint8_t *buf, uint32_t len);
+
+#endif /* ifndef _RINGBUF_H */
@@ -0,0 +1,103 @@
+/**
+ * sched.c
+ * Round-robin run queue and time slice accounting
+ *
+ * Author: James Nicholson
+ */
+
+#include "sched.h"
+#include <stddef.h>
+
+/**
+ * Implementation Notes
+ *
+ * The run queue is a singly linked FIFO threaded through pcb->next, so
+ * making a process ready and picking the next one are both O(1). The
+ * running process is never on the queue; sched_switch puts it back on the
+ * tail when its slice ends, which gives plain round-robin order. A process
+ * that blocked or exited has already changed its own state, so it is simply
+ * not requeued.
+ */
+
+void sched_init(struct scheduler *s, struct pcb *current, struct pcb *idle, uint32_t quantum)
+{
+    s->head = NULL;
+    s->tail = NULL;
+    s->current = current;
+    s->idle = idle;
+    s->quantum = quantum;
+    s->remaining = quantum;
+    s->ticks = 0;
+    current->state = PROC_RUNNING;
+}
+
+static void enqueue(struct scheduler *s, struct pcb *p)
+{
+    p->state = PROC_READY;
+    p->next = NULL;
+    if (s->tail == NULL)
+    {
+        s->head = p;
+    }
+    else
+    {
+        s->tail->next = p;
+    }
+    s->tail = p;
+}
+
+void sched_ready(struct scheduler *s, struct pcb *p)
+{
+    if (p == s->idle || p->state == PROC_READY || p->state == PROC_RUNNING)
+    {
+        return;
+    }
+    enqueue(s, p);
+}
+
+int sched_tick(struct scheduler *s)
+{
+    s->ticks++;
+    s->current->ticks++;
+    if (s->remaining > 0)
+    {
+        s->remaining--;
+    }
+    if (s->current->state != PROC_RUNNING)
+    {
+        return 1;
+    }
+    if (s->head == NULL)
+    {
+        // Nobody is waiting, so the running process keeps the CPU.
+        return 0;
+    }
+    return s->current == s->idle || s->remaining == 0;
+}
+
+struct pcb *sched_switch(struct scheduler *s)
+{
+    struct pcb *prev = s->current;
+    if (prev != s->idle && prev->state == PROC_RUNNING)
+    {
+        enqueue(s, prev);
+    }
+    struct pcb *next = s->head;
+    if (next == NULL)
+    {
+        next = s->idle;
+    }
+    else
+    {
+        s->head = next->next;
+        if (s->head == NULL)
+        {
+            s->tail = NULL;
+        }
+        next->next = NULL;
+    }
+    next->state = PROC_RUNNING;
+    s->current = next;
+    s->remaining = s->quantum;
+    return next;
+}
@@ -0,0 +1,56 @@
+/**
+ * sched.h
+ * Round-robin run queue and time slice accounting
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include <stdint.h>
+#include "pcb.h"
+
+/**
+ * Scheduler state. Nothing in here touches hardware: the caller feeds
+ * sched_tick from its tick source and performs the context switch that
+ * sched_switch selects, so the policy runs the same on the board and
+ * against a simulated tick on a host.
+ */
+struct scheduler
+{
+    struct pcb *head; // first READY process
+    struct pcb *tail; // last READY process
+    struct pcb *current; // the RUNNING process
+    struct pcb *idle; // runs when nothing else is READY, never queued
+    uint32_t quantum; // ticks in a full time slice
+    uint32_t remaining; // ticks left in the current time slice
+    uint32_t ticks; // ticks since sched_init
+};
+
+/**
+ * Initialize s with current as the running process. idle runs whenever the
+ * run queue is empty.
+ */
+void sched_init(struct scheduler *s, struct pcb *current, struct pcb *idle, uint32_t quantum);
+
+/**
+ * Mark p READY and append it to the run queue. Does nothing if p is already
+ * READY or RUNNING, so a wakeup may be delivered more than once.
+ */
+void sched_ready(struct scheduler *s, struct pcb *p);
+
+/**
+ * Account one tick to the running process.
+ * Returns: 1 if the running process should be switched out now, 0 otherwise
+ */
+int sched_tick(struct scheduler *s);
+
+/**
+ * Requeue the running process if it is still RUNNING, then make the process
+ * at the head of the run queue (or idle) current and give it a full slice.
+ * Returns: the new current process
+ */
+struct pcb *sched_switch(struct scheduler *s);
+
+#endif /* ifndef _SCHED_H */
@@ -14,6 +14,13 @@
 #include "SDHC_FAT32_Files.h"
 #include "sdram.h"
 #include "svc.h"
+#include "arena.h"
+#include "proc.h"
+#include "mySTDSTRMdriver.h"
+#include "dwt.h"
+#include "aio.h"
+#include "clock.h"
+#include "microSD.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -71,6 +78,19 @@ char *help_text =
 "memory should be checked against, and the third [length] is the length(in bytes) of the specified "
 "memory. Each of the three arguments can be provided in octal, decimal, or hexidecimal (see malloc).\n"
 "\n"
+"memstat\n"
+"Outputs allocator statistics: bytes in use and free, peak usage, the largest free block, "
+"allocation counters, bytes in use per PID, and block counts by power of two size class. "
+"Unlike memorymap this does not walk the heap, so it is safe to run on a busy system.\n"
+"\n"
+"svcstat\n"
+"Outputs the number of calls and the average core cycles spent in the kernel for each supervisor call.\n"
+"\n"
+"heapcheck [blocks]\n"
+"Verifies up to [blocks] heap regions (optional, default 64), resuming where the previous heapcheck "
+"stopped, so repeated runs sweep the whole heap without stalling the system. With MALLOC_DEBUG "
+"enabled each region's header checksum and trailing canary are verified as well.\n"
+"\n"
 "open [path]\n"
 "Opens the file located at [path] and provides a file descriptor that can be used to reference the "
 "open file in other operations. [path] must be the absolute path of the file, i.e. /MYFILE.TXT. "
@@ -96,9 +116,51 @@ char *help_text =
 "\n"
 "ls\n"
 "List all the files in the current directory.\n"
+"\n"
+"sync\n"
+"Copies every file in /tmp to the root directory of the microSD card under the same name, replacing "
+"the file there. Files in /tmp whose names are not uppercase 8.3 names are not copied.\n"
+"\n"
+"run [path]\n"
+"Runs the commands in the file at [path] (optional), one per line, without printing a prompt or echoing "
+"them. [path] may be a file on the card or in /tmp, or a pipe, i.e. run /SETUP.SH. Without [path] the "
+"commands are read from the console until end of transmission (Ctrl-D), so a script can be sent to the "
+"board straight from a host. Each line may be up to 255 characters. A command that fails prints its error "
+"and the script carries on.\n"
+"\n"
+"time [command]...\n"
+"Runs [command] with its arguments, i.e. time ls, then reports how long it took in microseconds and core "
+"cycles, how many supervisor calls it made, how many microSD card sectors were read and written, and how "
+"many bytes were allocated from the heap. The counts are system wide, so they include anything other "
+"processes did meanwhile.\n"
+"\n"
+"poll [timeout] [file descriptor]...\n"
+"Waits up to [timeout] milliseconds for any of the open [file descriptor]s to be ready to read or write "
+"without waiting, then lists those that are, i.e. poll 5000 0 3 waits up to five seconds for console input "
+"or for the device open as 3. A [timeout] of 0 checks without waiting.\n"
+"\n"
 
 "DEVICES:\n"
 "\n"
+"STANDARD STREAMS\n"
+"Every process starts with stdin, stdout and stderr open as file descriptors 0, 1 and 2. "
+"stdout is buffered and is flushed before each prompt; stderr is written immediately.\n"
+"\n"
+"NULL AND ZERO\n"
+"Anything written to /dev/null or /dev/zero is discarded. Reading /dev/null always reports end of file; "
+"reading /dev/zero returns as many zero bytes as were asked for.\n"
+"\n"
+"RAM DISK\n"
+"/tmp/ is a 4 MB disk in SDRAM, much faster than the card but emptied at every reset. Files are created, "
+"opened, read, written and deleted as on the card, i.e. /tmp/SCRATCH, with names of up to 14 characters. "
+"Use sync to keep them.\n"
+"\n"
+"PIPES AND MESSAGE QUEUES\n"
+"/dev/pipe0 to /dev/pipe3 are pipes and /dev/mq0 to /dev/mq3 are message queues, shared by every process. "
+"A pipe carries a stream of bytes; reading an empty pipe waits for data, or reports end of file if no "
+"other stream has the pipe open. A message queue keeps each write as a separate message of up to 256 "
+"bytes and holds up to 16 of them; each read returns one message. Both wait when full.\n"
+"\n"
 "FAT32\n"
 "To open FAT32 files the [path] is the a forward slash followed by the filename:\n"
 "\n"
@@ -118,32 +180,40 @@ char *help_text =
 "To turn on an LED light, open it, and then write 'on' to its file descriptor:\n"
 "\n"
 "$ open /dev/ledb\n"
-"0\n"
-"$ write 0 on\n"
+"3\n"
+"$ write 3 on\n"
 "\n"
-"To turn it off, read zero characters from its file descriptor:"
+"To set its brightness, write a percentage, and to turn it off, write 'off' (reading zero characters "
+"from its file descriptor turns it off too):\n"
 "\n"
-"$ read 0 0\n"
+"$ write 3 25%\n"
+"$ write 3 off\n"
+"\n"
+"Only the blue and orange LEDs can be dimmed. The yellow and green LEDs are on at any level above 0%.\n"
 "\n"
 "PUSH BUTTONS\n"
-"There are four two push buttons mounted to the OS at startup, which can be accessed via their file paths.\n"
+"There are two push buttons mounted to the OS at startup, which can be accessed via their file paths.\n"
 "\n"
 "/dev/sw1\n"
 "/dev/sw2\n"
 "\n"
-"To check the status of a push button, open it and then read 1 character form its file descriptor:\n"
+"Each time a button is pressed or released an event is queued. Reading a button waits for an event and then "
+"returns as many queued events as fit, one per line:\n"
 "\n"
 "$ open /dev/sw2\n"
-"3\n"
-"$ read 3 1\n"
+"4\n"
+"$ read 4 64\n"
+"3 15210\n"
+"4 15388\n"
 "\n"
-"An integer will be printed to UART that corresponds to the state of the pushbutton at the moment the command was run:\n"
+"The first number is the event and the second is when it happened, in milliseconds since startup:\n"
 "\n"
-"0 - no change\n"
 "1 - sw1 is down\n"
 "2 - sw1 is up\n"
 "3 - sw2 is down\n"
 "4 - sw2 is up\n"
+"\n"
+"Up to 16 events are kept per button; later ones are dropped until the button is read.\n"
 "\n";
 
 // Maps error codes to error descriptions.
@@ -162,13 +232,21 @@ struct error_d
     {E_MALLOC, "Unable to allocate the requested memory"},
     {E_STRTOL, "The number you provided is out of range, or contains an invalid character"},
     {E_BRANGE_EX, "The value provided exceeds the storage capacity of a byte"},
-    {E_ADDR_SPC, "The range of addresses specified is not within the current address space"}};
+    {E_ADDR_SPC, "The range of addresses specified is not within the current address space"},
+    {E_HEAP_CORRUPT, "The heap is corrupt: a region header checksum or canary does not match"},
+    {E_AIO_PENDING, "The asynchronous I/O request has not completed yet"},
+    {E_AIO_ID, "There is no asynchronous I/O request with that id"},
+    {E_AIO_FULL, "Too many asynchronous I/O requests are outstanding"},
+    {E_NO_ALARM, "No alarm is set"},
+    {E_DEVICE_REGISTRY_FULL, "There is no room to register another device"},
+    {E_LED_LEVEL, "An LED level must be on, off, or a percentage from 0% to 100%"},
+    {E_LINE_TOO_LONG, "A line of the script is longer than 255 characters"}};
 
 // Convenience function to print error codes.
 void print_err(int error_c)
 {
 	int i;
-    for (i = 0; i <= E_COUNT; i++)
+    for (i = 0; i < sizeof(error_ds) / sizeof(error_ds[0]); i++)
     {
         if (error_c == error_ds[i].code)
         {
@@ -179,11 +257,7 @@ void print_err(int error_c)
     myprintf("ERROR (%d): see utils.h for enum value that can be used to search source code. Will add error text in a future PR.\n", error_c);
 }
 
-struct commandEntry
-{
-    char *name;
-    int (*functionp)(int argc, char *argv[]);
-} commands[] = {
+struct commandEntry commands[] = {
     {"echo", cmd_echo},
     {"exit", cmd_exit},
     {"help", cmd_help},
@@ -192,162 +266,186 @@ struct commandEntry
     {"memoryMap", cmd_memory_map},
     {"memset", cmd_memset},
     {"memchk", cmd_memchk},
+    {"memstat", cmd_memstat},
+    {"svcstat", cmd_svcstat},
+    {"heapcheck", cmd_heapcheck},
     {"open", cmd_open},
     {"close", cmd_close},
     {"create", cmd_create},
     {"read", cmd_read},
     {"write", cmd_write},
     {"delete", cmd_delete},
-    {"ls", cmd_ls}
+    {"ls", cmd_ls},
+    {"sync", cmd_sync},
+    {"poll", cmd_poll},
+    {"run", cmd_run},
+    {"time", cmd_time}
     };
 
-typedef int (*cmd_pntr)(int argc, char *argv[]);
+const int commands_count = sizeof(commands) / sizeof(commands[0]);
 
+/**
+ * Commands are found through a perfect hash of their names: cmd_table_init
+ * tries seeds until every command lands in its own slot of cmd_table, so a
+ * lookup costs one hash of the name and one strcmp to reject anything that
+ * isn't a command.
+ */
+static struct commandEntry *cmd_table[CMD_TABLE_SIZE];
+static uint32_t cmd_seed;
 
-cmd_pntr find_cmd(char *arg)
+// FNV-1a, as used by the device registry, with the seed mixed into its basis
+static uint32_t cmd_hash(const char *name, uint32_t seed)
 {
-    for (int i = 0; i < sizeof(commands)/sizeof(commands[0]); i++)
+    uint32_t hash = 2166136261u ^ seed;
+    while (*name != '\0')
     {
-        if (strcmp(arg, commands[i].name) == 0)
-        {
-            return commands[i].functionp;
-        }
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
     }
-    return NULL;
+    // The top bits depend on every character; the bottom ones barely on the seed
+    return hash >> (32 - CMD_TABLE_BITS);
 }
 
-#define BUFFER_SIZE_FOR_SHELL_INPUT 256
-
-int shell(int argc, char **argv)
+int cmd_table_init(void)
 {
-    while (1)
+    for (uint32_t seed = 0; seed < CMD_SEED_TRIES; seed++)
     {
-        char linebuf[BUFFER_SIZE_FOR_SHELL_INPUT];
-        memset(linebuf, 0, BUFFER_SIZE_FOR_SHELL_INPUT);
-        myprintf("$ ");
-        uartGetline(UART2_BASE_PTR, &linebuf[0], BUFFER_SIZE_FOR_SHELL_INPUT);
-        // Iterate over characters in the line buffer and set whitespace to the null terminator.
-        for (int i = 0; i < BUFFER_SIZE_FOR_SHELL_INPUT; i++)
-        {
-        	char c = linebuf[i];
-            if (c == ' ' || c == '\t')
-            {
-                linebuf[i] = 0;
-            }
-        }
-        // Previous character type.
-        // 0 = whitespace, 1 = character.
-        char pctype = 0;
-        // Argument count.
-        int argct = 0;
-        // Iterate over characters in the line buffer and set argct, argval.
-        for (int i = 0; i < BUFFER_SIZE_FOR_SHELL_INPUT; i++)
+        memset(cmd_table, 0, sizeof(cmd_table));
+        int placed = 0;
+        while (placed < commands_count)
         {
-            // If previous character is a space.
-            if (pctype == 0)
-            {
-                // If current character is also a space.
-                if (linebuf[i] == 0)
-                {
-                    continue;
-                }
-                // If current character is a character.
-                else
-                {
-                    // Increment arg count, set arg pointer, set prev char type to character.
-                    argct++;
-                    pctype = 1;
-                }
-            }
-            // If previous character is a character.
-            else
+            uint32_t slot = cmd_hash(commands[placed].name, seed);
+            if (cmd_table[slot] != NULL)
             {
-                // If current character is a space.
-                if (linebuf[i] == 0)
-                {
-                    // Set prev char type to space.
-                    pctype = 0;
-                }
+                break;
             }
+            cmd_table[slot] = &commands[placed];
+            placed++;
         }
-        // Initialize argument start indexes array.
-        int arglocs[argct];
-        // Initialize argument lengths array.
-        int arglens[argct];
-        int arglocct = 0;
-        // Re-initialize previous character type to 0.
-        pctype = 0;
-        for (int i = 0; i < BUFFER_SIZE_FOR_SHELL_INPUT; i++)
+        if (placed == commands_count)
         {
-            // If previous character is a space.
-            if (pctype == 0)
-            {
-                // If current character is also a space.
-                if (linebuf[i] == 0)
-                {
-                    continue;
-                }
-                // If current character is a character.
-                else
-                {
-                    // Set argument start index.
-                    arglocs[arglocct] = i;
-                    pctype = 1;
-                }
-            }
-            // If previous character is a character.
-            else
-            {
-                // If current character is a space.
-                if (linebuf[i] == 0 || linebuf[i] == '\n')
-                {
-                    // Set argument length.
-                    arglens[arglocct] = i - arglocs[arglocct];
-                    arglocct++;
-                    // Set prev char type to space.
-                    pctype = 0;
-                }
-            }
+            cmd_seed = seed;
+            return E_SUCCESS;
         }
-        // If there are no args (i.e. user pressed enter or space enter) continue before mallocing
-        if (argct < 1)
+    }
+    return E_GENERIC;
+}
+
+cmd_pntr find_cmd(char *arg)
+{
+    struct commandEntry *entry = cmd_table[cmd_hash(arg, cmd_seed)];
+    if (entry == NULL || strcmp(arg, entry->name) != 0)
+    {
+        return NULL;
+    }
+    return entry->functionp;
+}
+
+static int is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+int shell_tokenize(char *line, char *argv[], int max_args, int *argcp)
+{
+    int argc = 0;
+    char *p = line;
+    while (1)
+    {
+        while (is_blank(*p))
         {
-            continue;
+            p++;
         }
-        // Allocate space for argval
-        char **argval = myMalloc((argct + 1) * sizeof(char *));
-        for (int i = 0; i < argct; i++)
+        if (*p == '\0')
         {
-            // Assign argvals
-            argval[i] = myMalloc((arglens[i] + 1) * sizeof(char));
-            // Zero out argval[i] plus a NUL terminator
-            myMemset(argval[i], 0, arglens[i] + 1);
-            strncpy(argval[i], &linebuf[arglocs[i]], arglens[i]);
+            break;
         }
-        argval[argct] = NULL;
-        cmd_pntr shell_cmd = find_cmd(argval[0]);
-        if (shell_cmd == NULL)
+        if (argc == max_args)
         {
-            print_err(E_CMD_NOT_FND);
+            return E_TOO_MANY_ARGS;
         }
-        else
+        argv[argc++] = p;
+        while (*p != '\0' && !is_blank(*p))
         {
-            // Only pass the arguments, not the shell command.
-            int cmd_c = shell_cmd(argct - 1, &argval[1]);
-            // If the command returns a non-zero error code, print the error message.
-            if (cmd_c > 0)
-            {
-                print_err(cmd_c);
-            }
+            p++;
         }
-        // Free argval[i] and argval
-        int i = 0;
-        while (i < argct)
+        if (*p == '\0')
         {
-            myFree(argval[i]);
-            ++i;
+            break;
         }
-        myFree(argval);
+        *p++ = '\0';
+    }
+    argv[argc] = NULL;
+    *argcp = argc;
+    return E_SUCCESS;
+}
+
+#define BUFFER_SIZE_FOR_SHELL_INPUT 256
+
+/**
+ * Scratch memory for the command line currently being run. The shell resets
+ * it after every command, so commands may allocate from it freely and never
+ * free what they allocate.
+ */
+struct arena *cmd_scratch;
+
+void execute_line(char *line)
+{
+    arena_reset(cmd_scratch);
+    char *argval[SHELL_MAX_ARGS + 1];
+    int argct;
+    int tokenize_status = shell_tokenize(line, argval, SHELL_MAX_ARGS, &argct);
+    if (tokenize_status != E_SUCCESS)
+    {
+        print_err(tokenize_status);
+        return;
+    }
+    // If there are no args (i.e. user pressed enter or space enter) there is nothing to run
+    if (argct < 1)
+    {
+        return;
+    }
+    cmd_pntr shell_cmd = find_cmd(argval[0]);
+    if (shell_cmd == NULL)
+    {
+        print_err(E_CMD_NOT_FND);
+        return;
+    }
+    // Only pass the arguments, not the shell command.
+    int cmd_c = shell_cmd(argct - 1, &argval[1]);
+    // If the command returns a non-zero error code, print the error message.
+    if (cmd_c > 0)
+    {
+        print_err(cmd_c);
+    }
+}
+
+int shell(int argc, char **argv)
+{
+    cmd_scratch = arena_create(SHELL_SCRATCH_SIZE);
+    if (cmd_scratch == NULL)
+    {
+        print_err(E_MALLOC);
+        return E_MALLOC;
+    }
+    int cmd_table_status = cmd_table_init();
+    if (cmd_table_status != E_SUCCESS)
+    {
+        print_err(cmd_table_status);
+        return cmd_table_status;
+    }
+    if (TEST_MODE)
+    {
+        run_process_test_suite();
+    }
+    while (1)
+    {
+        char linebuf[BUFFER_SIZE_FOR_SHELL_INPUT];
+        myprintf("$ ");
+        file_descriptor stdout_fd = STDOUT_FD;
+        myfflush(&stdout_fd);
+        uartGetline(UART2_BASE_PTR, &linebuf[0], BUFFER_SIZE_FOR_SHELL_INPUT);
+        execute_line(linebuf);
     }
 }
 
@@ -515,6 +613,111 @@ int cmd_memchk(int argc, char *argv[])
     return myMemchk(start_p, (uint8_t)byte_val, size);
 }
 
+/**
+ * Shell "svcstat" command
+ */
+int cmd_svcstat(int argc, char *argv[])
+{
+    if (argc > 0)
+    {
+        return E_TOO_MANY_ARGS;
+    }
+    struct svc_stats stats[SVC_COUNT];
+    int svcstat_status = SVCMysvcstats(stats);
+    if (svcstat_status != E_SUCCESS)
+    {
+        return svcstat_status;
+    }
+    myprintf("\n%5s%12s%12s\n", "SVC", "Calls", "Avg cycles");
+    for (int i = 0; i < SVC_COUNT; i++)
+    {
+        if (stats[i].calls != 0)
+        {
+            myprintf("%5d%12lu%12lu\n", i, (unsigned long)stats[i].calls,
+                     (unsigned long)(stats[i].cycles / stats[i].calls));
+        }
+    }
+    return E_SUCCESS;
+}
+
+/**
+ * Shell "memstat" command
+ */
+int cmd_memstat(int argc, char *argv[])
+{
+    if (argc > 0)
+    {
+        return E_TOO_MANY_ARGS;
+    }
+    struct mem_stats stats;
+    int memstat_status = SVCMymemstat(&stats);
+    if (memstat_status != E_SUCCESS)
+    {
+        return memstat_status;
+    }
+    myprintf("\n");
+    myprintf("%-16s%12lu\n", "In use", (unsigned long)stats.bytes_in_use);
+    myprintf("%-16s%12lu\n", "Free", (unsigned long)stats.bytes_free);
+    myprintf("%-16s%12lu\n", "Peak in use", (unsigned long)stats.peak_in_use);
+    myprintf("%-16s%12lu\n", "Largest free", (unsigned long)stats.largest_free);
+    myprintf("%-16s%12lu\n", "Used blocks", (unsigned long)stats.used_blocks);
+    myprintf("%-16s%12lu\n", "Free blocks", (unsigned long)stats.free_blocks);
+    myprintf("%-16s%12lu\n", "Alloc calls", (unsigned long)stats.alloc_calls);
+    myprintf("%-16s%12lu\n", "Bytes allocated", (unsigned long)stats.bytes_allocated);
+    myprintf("%-16s%12lu\n", "Free calls", (unsigned long)stats.free_calls);
+    myprintf("%-16s%12lu\n", "Failed allocs", (unsigned long)stats.failed_allocs);
+    myprintf("%-16s%12lu\n", "Small pages", (unsigned long)stats.small_pages);
+    myprintf("\n%5s%12s\n", "PID", "Bytes");
+    for (int i = 0; i < MEM_STATS_MAX_PID; i++)
+    {
+        if (stats.pid_bytes[i] != 0)
+        {
+            myprintf("%5d%12lu\n", i, (unsigned long)stats.pid_bytes[i]);
+        }
+    }
+    myprintf("\n%12s%8s%8s\n", "Class", "Used", "Free");
+    for (int i = 0; i < MEM_STATS_SIZE_CLASSES; i++)
+    {
+        if (stats.used_class[i] != 0 || stats.free_class[i] != 0)
+        {
+            myprintf("%12lu%8lu%8lu\n", 1UL << i,
+                     (unsigned long)stats.used_class[i], (unsigned long)stats.free_class[i]);
+        }
+    }
+    myprintf("\n");
+    return E_SUCCESS;
+}
+
+/**
+ * Shell "heapcheck" command
+ */
+int cmd_heapcheck(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        return E_TOO_MANY_ARGS;
+    }
+    long max_blocks = HEAPCHECK_DEFAULT_BLOCKS;
+    if (argc == 1)
+    {
+        max_blocks = my_strtoul(argv[0]);
+        if (max_blocks < 0)
+        {
+            return E_STRTOL;
+        }
+    }
+    uint32_t checked;
+    void *bad_region;
+    int check_status = heapCheck(max_blocks, &checked, &bad_region);
+    if (check_status != E_SUCCESS)
+    {
+        myprintf("Corrupt region at %p after %lu regions\n", bad_region, (unsigned long)checked);
+        return check_status;
+    }
+    myprintf("%lu regions ok\n", (unsigned long)checked);
+    return E_SUCCESS;
+}
+
 /**
  * Shell "create" command
  */
@@ -612,8 +815,13 @@ int cmd_read(int argc, char *argv[])
         return E_READ_LIMIT;
     }
     int num_chars_act = 0;
-    char raw_file_chars[512];
-    char clean_file_chars[512];
+    char *raw_file_chars = arena_alloc(cmd_scratch, 512);
+    // char_wash expands each non-printing character to five
+    char *clean_file_chars = arena_alloc(cmd_scratch, 512 * 5 + 1);
+    if (raw_file_chars == NULL || clean_file_chars == NULL)
+    {
+        return E_MALLOC;
+    }
     int get_buf_status = SVCMyfgetc(fd, &raw_file_chars[0], num_chars_req, &num_chars_act);
     if (get_buf_status != E_SUCCESS) {
         return get_buf_status;
@@ -641,7 +849,11 @@ int cmd_write(int argc, char *argv[])
         return E_STRTOL;
     }
     file_descriptor fd = (file_descriptor)fd_long;
-    char buffer[BUFFER_SIZE_FOR_SHELL_INPUT]; // holds the rendered string
+    char *buffer = arena_alloc(cmd_scratch, BUFFER_SIZE_FOR_SHELL_INPUT); // holds the rendered string
+    if (buffer == NULL)
+    {
+        return E_MALLOC;
+    }
     int bufpos = 0;
     for (int i=1; i<argc; i++) {
         int j = 0;
@@ -685,9 +897,260 @@ int cmd_ls(int argc, char *argv[])
     return E_SUCCESS;
 }
 
+/**
+ * A script is read SCRIPT_READ_SIZE bytes at a time, from a stream or, with
+ * console set, straight from UART2 so that nothing is echoed.
+ */
+struct script
+{
+    file_descriptor fd;
+    int console;
+    int eof;
+    int used; // bytes in buf
+    int pos; // bytes of buf already split into lines
+    char buf[SCRIPT_READ_SIZE];
+};
+
+static void script_fill(struct script *s)
+{
+    s->used = 0;
+    s->pos = 0;
+    if (s->console)
+    {
+        // Stop at the end of each line so a command runs as soon as it is sent
+        while (s->used < SCRIPT_READ_SIZE)
+        {
+            char c = uartGetchar(UART2_BASE_PTR);
+            if (c == SCRIPT_END_OF_TRANSMISSION)
+            {
+                s->eof = 1;
+                return;
+            }
+            s->buf[s->used++] = c;
+            if (c == '\n' || c == '\r')
+            {
+                return;
+            }
+        }
+        return;
+    }
+    int charsread = 0;
+    int read_status = SVCMyfgetc(s->fd, s->buf, SCRIPT_READ_SIZE, &charsread);
+    s->used = charsread;
+    if (read_status != E_SUCCESS || charsread == 0)
+    {
+        s->eof = 1;
+    }
+}
+
+/**
+ * Run each line of s, stopping at its end.
+ */
+static void script_run(struct script *s)
+{
+    char line[BUFFER_SIZE_FOR_SHELL_INPUT];
+    int len = 0;
+    int too_long = 0;
+    while (1)
+    {
+        if (s->pos == s->used)
+        {
+            if (s->eof)
+            {
+                break;
+            }
+            script_fill(s);
+            continue;
+        }
+        char c = s->buf[s->pos++];
+        if (c != '\n' && c != '\r')
+        {
+            if (len < BUFFER_SIZE_FOR_SHELL_INPUT - 1)
+            {
+                line[len++] = c;
+            }
+            else
+            {
+                too_long = 1;
+            }
+            continue;
+        }
+        line[len] = '\0';
+        if (too_long)
+        {
+            print_err(E_LINE_TOO_LONG);
+        }
+        else
+        {
+            execute_line(line);
+        }
+        len = 0;
+        too_long = 0;
+    }
+    // The last line need not end with a new-line
+    if (len > 0 && !too_long)
+    {
+        line[len] = '\0';
+        execute_line(line);
+    }
+}
+
+/**
+ * Shell "run" command
+ */
+int cmd_run(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        return E_TOO_MANY_ARGS;
+    }
+    // Too big for the scratch arena, which each line of the script resets
+    struct script *s = myMalloc(sizeof(struct script));
+    if (s == NULL)
+    {
+        return E_MALLOC;
+    }
+    s->console = argc == 0;
+    s->eof = 0;
+    s->used = 0;
+    s->pos = 0;
+    if (!s->console)
+    {
+        int open_status = SVCMyfopen(argv[0], &s->fd);
+        if (open_status != E_SUCCESS)
+        {
+            myFree(s);
+            return open_status;
+        }
+    }
+    script_run(s);
+    if (!s->console)
+    {
+        SVCMyfclose(&s->fd);
+    }
+    myFree(s);
+    return E_SUCCESS;
+}
+
+/**
+ * Shell "time" command
+ */
+int cmd_time(int argc, char *argv[])
+{
+    if (argc < 1)
+    {
+        return E_NOT_ENOUGH_ARGS;
+    }
+    cmd_pntr timed_cmd = find_cmd(argv[0]);
+    if (timed_cmd == NULL)
+    {
+        return E_CMD_NOT_FND;
+    }
+    struct mem_stats mem_before;
+    struct mem_stats mem_after;
+    int memstat_status = SVCMymemstat(&mem_before);
+    if (memstat_status != E_SUCCESS)
+    {
+        return memstat_status;
+    }
+    // Sample the counters in the reverse order afterwards so the timing's
+    // own memstat calls aren't counted
+    uint32_t svcs = svc_total_calls;
+    uint32_t blocks_read = sdhc_blocks_read;
+    uint32_t blocks_written = sdhc_blocks_written;
+    uint64_t cycles = clock_cycles();
+    int cmd_c = timed_cmd(argc - 1, &argv[1]);
+    cycles = clock_cycles() - cycles;
+    blocks_written = sdhc_blocks_written - blocks_written;
+    blocks_read = sdhc_blocks_read - blocks_read;
+    svcs = svc_total_calls - svcs;
+    memstat_status = SVCMymemstat(&mem_after);
+    if (memstat_status != E_SUCCESS)
+    {
+        return memstat_status;
+    }
+    if (cmd_c > 0)
+    {
+        print_err(cmd_c);
+    }
+    myprintf("\n");
+    myprintf("%-16s%12lu us\n", "Time", (unsigned long)(cycles / CLOCK_CYCLES_PER_US));
+    // The nano C library's printf has no %llu, so the cycle count is
+    // converted to decimal here
+    char cycles_text[21];
+    char *digit = &cycles_text[sizeof(cycles_text) - 1];
+    uint64_t remaining = cycles;
+    *digit = '\0';
+    do
+    {
+        *--digit = '0' + (char)(remaining % 10);
+        remaining /= 10;
+    } while (remaining > 0);
+    myprintf("%-16s%12s\n", "Cycles", digit);
+    myprintf("%-16s%12lu\n", "SVCs", (unsigned long)svcs);
+    myprintf("%-16s%12lu\n", "Sectors read", (unsigned long)blocks_read);
+    myprintf("%-16s%12lu\n", "Sectors written", (unsigned long)blocks_written);
+    myprintf("%-16s%12lu\n", "Bytes allocated", (unsigned long)(mem_after.bytes_allocated - mem_before.bytes_allocated));
+    return E_SUCCESS;
+}
+
+/**
+ * Shell "poll" command
+ */
+int cmd_poll(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        return E_NOT_ENOUGH_ARGS;
+    }
+    int nfds = argc - 1;
+    struct poll_fd *fds = arena_alloc(cmd_scratch, nfds * sizeof(struct poll_fd));
+    if (fds == NULL)
+    {
+        return E_MALLOC;
+    }
+    for (int i = 0; i < nfds; i++)
+    {
+        fds[i].fd = (file_descriptor)my_strtoul(argv[i + 1]);
+        fds[i].events = POLL_IN | POLL_OUT;
+    }
+    int nready = 0;
+    int poll_status = SVCMypoll(fds, nfds, (int)my_strtoul(argv[0]), &nready);
+    if (poll_status != E_SUCCESS)
+    {
+        return poll_status;
+    }
+    if (nready == 0)
+    {
+        myprintf("timed out\n");
+    }
+    for (int i = 0; i < nfds; i++)
+    {
+        if (fds[i].revents != 0)
+        {
+            myprintf("%lu:%s%s\n", (unsigned long)fds[i].fd, (fds[i].revents & POLL_IN) ? " in" : "",
+                (fds[i].revents & POLL_OUT) ? " out" : "");
+        }
+    }
+    return E_SUCCESS;
+}
+
+/**
+ * Shell "sync" command
+ */
+int cmd_sync(int argc, char *argv[])
+{
+    if (argc > 0)
+    {
+        return E_TOO_MANY_ARGS;
+    }
+    return SVCMytmp_sync();
+}
+
 int main(int argc, char **argv)
 {
     mcgInit();
+    dwt_init();
     setvbuf(stdout, NULL, _IONBF, 0);
     initUART();
     sdramInit();
@@ -696,5 +1159,11 @@ int main(int argc, char **argv)
     {
         run_test_suite();
     }
-    shell(argc, argv);
+    if (proc_init() != E_SUCCESS || aio_init() != E_SUCCESS ||
+        proc_create(shell, argc, argv, NULL) != E_SUCCESS)
+    {
+        print_err(E_MALLOC);
+        return E_MALLOC;
+    }
+    proc_start();
 }
\ No newline at end of file
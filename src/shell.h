@@ -1,6 +1,82 @@
 #ifndef _MYSHELL_H
 #define _MYSHELL_H
 
+#include "arena.h"
+
+/**
+ * Size in bytes of the per command line scratch arena.
+ */
+#define SHELL_SCRATCH_SIZE 16384
+
+/**
+ * Number of heap regions the heapcheck command verifies when not told otherwise.
+ */
+#define HEAPCHECK_DEFAULT_BLOCKS 64
+
+/**
+ * Most arguments a command line may have. A 256 character line can't hold
+ * more than 128.
+ */
+#define SHELL_MAX_ARGS 128
+
+/**
+ * The command lookup table has 1 << CMD_TABLE_BITS slots, a few times the
+ * number of commands, and cmd_table_init tries up to CMD_SEED_TRIES seeds
+ * to find a hash that gives each command a slot of its own.
+ */
+#define CMD_TABLE_BITS 7
+#define CMD_TABLE_SIZE (1 << CMD_TABLE_BITS)
+#define CMD_SEED_TRIES 4096
+
+typedef int (*cmd_pntr)(int argc, char *argv[]);
+
+struct commandEntry
+{
+    char *name;
+    cmd_pntr functionp;
+};
+
+extern struct commandEntry commands[];
+extern const int commands_count;
+
+/**
+ * Build the command lookup table used by find_cmd.
+ * Returns: E_SUCCESS, or E_GENERIC if no seed gives a perfect hash
+ */
+int cmd_table_init(void);
+
+/**
+ * Returns: the function implementing command name, or NULL if there is none
+ */
+cmd_pntr find_cmd(char *name);
+
+/**
+ * Split line in place into at most max_args words separated by spaces,
+ * tabs and new-lines, in one pass. The words are NUL terminated where they
+ * lie and pointed to by argv[0] to argv[*argcp - 1]; argv[*argcp] is set
+ * to NULL, so argv must have room for max_args + 1 pointers.
+ * Returns: E_SUCCESS, or E_TOO_MANY_ARGS
+ */
+int shell_tokenize(char *line, char *argv[], int max_args, int *argcp);
+
+/**
+ * Size of each read of a script by the run command, and the character that
+ * ends a script sent over the console.
+ */
+#define SCRIPT_READ_SIZE 512
+#define SCRIPT_END_OF_TRANSMISSION 0x04
+
+/**
+ * Split line into words and run the command they name, printing its error
+ * if it fails. Resets the scratch arena first.
+ */
+void execute_line(char *line);
+
+/**
+ * Scratch arena reset by the shell after each command returns.
+ */
+extern struct arena *cmd_scratch;
+
 // Shell command function prototypes.
 int cmd_date(int argc, char *argv[]);
 int cmd_echo(int argc, char *argv[]);
@@ -12,11 +88,18 @@ int cmd_free(int argc, char *argv[]);
 int cmd_memory_map(int argc, char *argv[]);
 int cmd_memset(int argc, char *argv[]);
 int cmd_memchk(int argc, char *argv[]);
+int cmd_memstat(int argc, char *argv[]);
+int cmd_svcstat(int argc, char *argv[]);
+int cmd_heapcheck(int argc, char *argv[]);
 int cmd_open(int argc, char *argv[]);
 int cmd_create(int argc, char *argv[]);
 int cmd_read(int argc, char *argv[]);
 int cmd_write(int argc, char *argv[]);
 int cmd_ls(int argc, char *argv[]);
+int cmd_sync(int argc, char *argv[]);
+int cmd_poll(int argc, char *argv[]);
+int cmd_run(int argc, char *argv[]);
+int cmd_time(int argc, char *argv[]);
 int cmd_delete(int argc, char *argv[]);
 int cmd_close(int argc, char *argv[]);
 
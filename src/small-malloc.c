@@ -0,0 +1,254 @@
+/**
+ * small-malloc.c
+ * Size class allocator for small heap objects
+ *
+ * Author: James Nicholson
+ */
+
+#include "small-malloc.h"
+#include "utils.h"
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Implementation Notes
+ *
+ * A struct mem_region header costs 8 bytes per allocation, which doubles the
+ * footprint of an 8 byte object. Small objects instead live in pages carved
+ * from a dedicated zone. Each page starts with a struct small_page holding
+ * the owner PID and an allocation bitmap, so an object costs a single bit
+ * plus its share of the page header.
+ *
+ * Pages with at least one free object are kept on a doubly linked list per
+ * size class and PID bucket, so an allocation only looks past the pages of
+ * the few PIDs that share its bucket, not every page of its class. PIDs are
+ * handed out in order, so live processes rarely share a bucket. A page
+ * leaves the list when it fills and rejoins when one of
+ * its objects is freed; a page whose objects are all free goes back to the
+ * zone's free page list so that any class or PID can reuse it.
+ */
+
+#define SMALL_PAGE_HEADER_SIZE ((sizeof(struct small_page) + 7) & ~7)
+
+static uint8_t *zone_start;
+static uint8_t *zone_end;
+// Pages below zone_unused have been handed out at least once
+static uint8_t *zone_unused;
+static struct small_page *free_pages;
+static struct small_page *class_pages[SMALL_CLASSES][SMALL_PID_BUCKETS];
+static uint32_t pages_in_use;
+
+void small_init(void *zone, uint32_t size)
+{
+    zone_start = (uint8_t *)zone;
+    zone_end = zone_start + size;
+    zone_unused = zone_start;
+    free_pages = NULL;
+    memset(class_pages, 0, sizeof(class_pages));
+    pages_in_use = 0;
+}
+
+int small_contains(const void *p)
+{
+    return (const uint8_t *)p >= zone_start && (const uint8_t *)p < zone_end;
+}
+
+static struct small_page *page_of(const void *p)
+{
+    return (struct small_page *)((uintptr_t)p & ~(uintptr_t)(SMALL_PAGE_SIZE - 1));
+}
+
+static uint8_t *page_data(struct small_page *page)
+{
+    return (uint8_t *)page + SMALL_PAGE_HEADER_SIZE;
+}
+
+static int class_of(uint32_t size)
+{
+    int class_index = 0;
+    uint32_t class_size = SMALL_MIN_SIZE;
+    while (class_size < size)
+    {
+        class_size <<= 1;
+        class_index++;
+    }
+    return class_index;
+}
+
+static struct small_page **list_head(int class_index, uint32_t pid)
+{
+    return &class_pages[class_index][pid % SMALL_PID_BUCKETS];
+}
+
+static void list_push(struct small_page *page)
+{
+    struct small_page **head = list_head(page->class_index, page->pid);
+    page->prev = NULL;
+    page->next = *head;
+    if (*head != NULL)
+    {
+        (*head)->prev = page;
+    }
+    *head = page;
+}
+
+static void list_unlink(struct small_page *page)
+{
+    if (page->prev != NULL)
+    {
+        page->prev->next = page->next;
+    }
+    else
+    {
+        *list_head(page->class_index, page->pid) = page->next;
+    }
+    if (page->next != NULL)
+    {
+        page->next->prev = page->prev;
+    }
+}
+
+static struct small_page *page_create(int class_index, int pid)
+{
+    struct small_page *page;
+    if (free_pages != NULL)
+    {
+        page = free_pages;
+        free_pages = page->next;
+    }
+    else if (zone_unused < zone_end)
+    {
+        page = (struct small_page *)zone_unused;
+        zone_unused += SMALL_PAGE_SIZE;
+    }
+    else
+    {
+        return NULL;
+    }
+    page->pid = pid;
+    page->class_index = class_index;
+    page->size = SMALL_MIN_SIZE << class_index;
+    page->nslots = (SMALL_PAGE_SIZE - SMALL_PAGE_HEADER_SIZE) / page->size;
+    page->nfree = page->nslots;
+    // Mark the bits past the last slot as allocated so they are never found free
+    memset(page->bitmap, 0, sizeof(page->bitmap));
+    for (int slot = page->nslots; slot < SMALL_BITMAP_WORDS * 32; slot++)
+    {
+        page->bitmap[slot / 32] |= 1u << (slot % 32);
+    }
+    list_push(page);
+    pages_in_use++;
+    return page;
+}
+
+void *small_alloc(uint32_t size, int pid, uint32_t *class_size)
+{
+    int class_index = class_of(size);
+    struct small_page *page = *list_head(class_index, pid);
+    while (page != NULL && page->pid != pid)
+    {
+        page = page->next;
+    }
+    if (page == NULL)
+    {
+        page = page_create(class_index, pid);
+        if (page == NULL)
+        {
+            return NULL;
+        }
+    }
+    for (int word = 0; word < SMALL_BITMAP_WORDS; word++)
+    {
+        if (page->bitmap[word] != 0xFFFFFFFFu)
+        {
+            int bit = __builtin_ctz(~page->bitmap[word]);
+            page->bitmap[word] |= 1u << bit;
+            page->nfree--;
+            if (page->nfree == 0)
+            {
+                list_unlink(page);
+            }
+            *class_size = page->size;
+            return page_data(page) + (word * 32 + bit) * page->size;
+        }
+    }
+    // Unreachable: a page on the class list always has a free slot
+    return NULL;
+}
+
+/**
+ * Returns the slot index of p in its page, or -1 if p is not the start of an
+ * allocated object.
+ */
+static int slot_of(struct small_page *page, const void *p)
+{
+    if ((const uint8_t *)page >= zone_unused || (const uint8_t *)p < page_data(page))
+    {
+        return -1;
+    }
+    uint32_t offset = (const uint8_t *)p - page_data(page);
+    int slot = offset / page->size;
+    if (slot >= page->nslots || !(page->bitmap[slot / 32] & (1u << (slot % 32))))
+    {
+        return -1;
+    }
+    return slot;
+}
+
+int small_free(void *p, int pid, uint32_t *class_size)
+{
+    struct small_page *page = page_of(p);
+    int slot = slot_of(page, p);
+    if (slot < 0 || page_data(page) + slot * page->size != (uint8_t *)p)
+    {
+        return E_ADDR_NOT_ALLOCATED;
+    }
+    if (page->pid != pid)
+    {
+        return E_WRONG_PID;
+    }
+    page->bitmap[slot / 32] &= ~(1u << (slot % 32));
+    *class_size = page->size;
+    if (page->nfree == 0)
+    {
+        list_push(page);
+    }
+    page->nfree++;
+    if (page->nfree == page->nslots)
+    {
+        list_unlink(page);
+        page->next = free_pages;
+        free_pages = page;
+        pages_in_use--;
+    }
+    return E_SUCCESS;
+}
+
+int small_range_valid(const void *p, uint32_t len)
+{
+    struct small_page *page = page_of(p);
+    int slot = slot_of(page, p);
+    if (slot < 0)
+    {
+        return 0;
+    }
+    uint32_t end_of_slot = (slot + 1) * page->size;
+    uint32_t offset = (const uint8_t *)p - page_data(page);
+    return len <= end_of_slot - offset;
+}
+
+uint32_t small_owned_bytes(const void *p, int pid)
+{
+    struct small_page *page = page_of(p);
+    int slot = slot_of(page, p);
+    if (slot < 0 || page->pid != pid)
+    {
+        return 0;
+    }
+    return (slot + 1) * page->size - ((const uint8_t *)p - page_data(page));
+}
+
+uint32_t small_pages_in_use(void)
+{
+    return pages_in_use;
+}
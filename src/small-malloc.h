@@ -0,0 +1,83 @@
+/**
+ * small-malloc.h
+ * Size class allocator for small heap objects
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _SMALLMALLOC_H
+#define _SMALLMALLOC_H
+
+#include <stdint.h>
+
+/**
+ * Requests of at most SMALL_MAX_SIZE bytes are served from SMALL_PAGE_SIZE
+ * byte pages, each holding objects of a single power of two size class
+ * between SMALL_MIN_SIZE and SMALL_MAX_SIZE, all owned by the same PID.
+ */
+#define SMALL_PAGE_SIZE 4096
+#define SMALL_MIN_SIZE 8
+#define SMALL_MAX_SIZE 256
+#define SMALL_CLASSES 6
+#define SMALL_ZONE_SIZE (8 * 1024 * 1024)
+
+// Number of page lists per size class, each shared by the PIDs equal mod it
+#define SMALL_PID_BUCKETS 16
+
+// Enough bits for a page of SMALL_MIN_SIZE objects
+#define SMALL_BITMAP_WORDS (SMALL_PAGE_SIZE / SMALL_MIN_SIZE / 32)
+
+struct small_page
+{
+    struct small_page *next;
+    struct small_page *prev;
+    uint32_t pid;
+    uint16_t size;   // object size in bytes
+    uint16_t nslots; // number of objects the page holds
+    uint16_t nfree;  // number of those objects not allocated
+    uint16_t class_index;
+    uint32_t bitmap[SMALL_BITMAP_WORDS]; // bit set => object allocated
+};
+
+/**
+ * Initialize the small object zone of size bytes at zone. zone must be
+ * SMALL_PAGE_SIZE aligned.
+ */
+void small_init(void *zone, uint32_t size);
+
+/**
+ * Returns 1 if p lies in the small object zone, 0 otherwise.
+ */
+int small_contains(const void *p);
+
+/**
+ * Allocate an object of at least size bytes owned by pid.
+ * The size actually reserved is returned in *class_size.
+ * Returns: a pointer to the object, or NULL if the zone is exhausted
+ */
+void *small_alloc(uint32_t size, int pid, uint32_t *class_size);
+
+/**
+ * Free the object at p on behalf of pid.
+ * The size of the freed object is returned in *class_size.
+ * Returns: E_SUCCESS, E_ADDR_NOT_ALLOCATED or E_WRONG_PID
+ */
+int small_free(void *p, int pid, uint32_t *class_size);
+
+/**
+ * Returns 1 if [p, p+len) lies within a single allocated small object.
+ */
+int small_range_valid(const void *p, uint32_t len);
+
+/**
+ * Returns the number of bytes from p to the end of the allocated small
+ * object containing p if pid owns it, or 0 otherwise.
+ */
+uint32_t small_owned_bytes(const void *p, int pid);
+
+/**
+ * Returns the number of pages currently assigned to a size class.
+ */
+uint32_t small_pages_in_use(void);
+
+#endif /* ifndef _SMALLMALLOC_H */
@@ -68,10 +68,19 @@
 #include <derivative.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "svc.h"
 #include "devinio.h"
 #include "my-malloc.h"
 #include "SDHC_FAT32_Files.h"
+#include "sdram.h"
+#include "pcb.h"
+#include "dwt.h"
+#include "utils.h"
+#include "aio.h"
+#include "proc.h"
+#include "clock.h"
+#include "myTMPdriver.h"
 
 #define XPSR_FRAME_ALIGNED_BIT 9
 #define XPSR_FRAME_ALIGNED_MASK (1<<XPSR_FRAME_ALIGNED_BIT)
@@ -227,6 +236,188 @@ int __attribute__((naked)) __attribute__((noinline)) SVCMydir_ls(void)
 }
 #pragma GCC diagnostic pop
 
+/**
+ * SVCMymemstat
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMymemstat(struct mem_stats *arg0)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_MEMSTAT));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMysvcstats
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMysvcstats(struct svc_stats *arg0)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_STATS));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMyio_submit
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMyio_submit(struct io_ring *arg0)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_IO_SUBMIT));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMyaio_read
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMyaio_read(file_descriptor arg0, char *arg1, int arg2, uint32_t *arg3)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_AIO_READ));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMyaio_write
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMyaio_write(file_descriptor arg0, char *arg1, int arg2, uint32_t *arg3)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_AIO_WRITE));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMyaio_status
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMyaio_status(uint32_t arg0, int *arg1)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_AIO_STATUS));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMyaio_wait
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMyaio_wait(uint32_t arg0, int *arg1)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_AIO_WAIT));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMysleep
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMysleep(uint32_t arg0)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_SLEEP));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMyalarm
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMyalarm(uint32_t arg0, uint32_t arg1)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_ALARM));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMyalarm_wait
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMyalarm_wait(uint32_t *arg0)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_ALARM_WAIT));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMyclock
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMyclock(uint64_t *arg0)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_CLOCK));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMytmp_sync
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMytmp_sync(void)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_TMP_SYNC));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
+/**
+ * SVCMypoll
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+int __attribute__((naked)) __attribute__((noinline)) SVCMypoll(struct poll_fd *arg0, int arg1, int arg2, int *arg3)
+{
+	__asm("svc %0"
+		  :
+		  : "I"(SVC_POLL));
+	__asm("bx lr");
+}
+#pragma GCC diagnostic pop
+
 /* This function sets the priority at which the SVCall handler runs (See
  * B3.2.11, System Handler Priority Register 2, SHPR2 on page B3-723 of
  * the ARM�v7-M Architecture Reference Manual, ARM DDI 0403Derrata
@@ -323,41 +514,321 @@ __asm void svcHandler(void) {
 }
 #endif
 
+/* Each SVC is described by an entry in svc_table: its handler, how many
+ * arguments it takes and which of them are pointers into the caller's
+ * memory.  svcHandlerInC checks every pointer argument before the handler
+ * sees it, so handlers can trust them. */
+
+typedef int (*svc_handler)(uint32_t *args);
+
+#define SVC_PTR(n) (1 << (n))
+
+/* A handler returns E_BLOCKED after putting the caller to sleep to have
+ * the SVC instruction run again once the caller is woken.  The caller's
+ * registers are left untouched, so it retries with the same arguments.
+ * Device code reached through an SVC blocks this way (see WAIT_EVENT_SVC). */
+
+/* Flag for SVCs that use the file system, which must wait while the
+ * asynchronous I/O worker is part way through a request */
+#define SVC_FS 0x01
+
+/* ptr_size of a null terminated string argument */
+#define SVC_STR 0xFFFF
+
+struct svc_entry {
+	svc_handler handler;
+	uint8_t nargs;
+	/* Bit n set if argument n is a pointer */
+	uint8_t ptr_mask;
+	/* Bit n set if the kernel only reads through pointer argument n, which
+	 * may then also point at the program's constants or static data */
+	uint8_t in_mask;
+	/* Index of the argument holding the length of the pointer argument
+	 * whose ptr_size is 0, or -1 if there is none */
+	int8_t len_arg;
+	/* Number of bytes the caller must own at each pointer argument, or
+	 * SVC_STR for a string, which must end inside memory the caller owns */
+	uint16_t ptr_size[SVC_MAX_ARGS];
+	uint8_t flags;
+};
+
+struct svc_stats svc_stats[SVC_COUNT];
+uint32_t svc_total_calls = 0;
+
+static int svc_fgetc(uint32_t *args) {
+	return myfgetc(args[0], (char *)args[1], args[2], (int *)args[3]);
+}
+
+static int svc_fputc(uint32_t *args) {
+	return myfputc((file_descriptor *)args[0], (char *)args[1], args[2]);
+}
+
+static int svc_fclose(uint32_t *args) {
+	return myfclose((file_descriptor *)args[0]);
+}
+
+static int svc_fcreate(uint32_t *args) {
+	return myfcreate((char *)args[0]);
+}
+
+static int svc_fdelete(uint32_t *args) {
+	return myfdelete((char *)args[0]);
+}
+
+static int svc_fopen(uint32_t *args) {
+	return myfopen((char *)args[0], (file_descriptor *)args[1]);
+}
+
+static int svc_malloc(uint32_t *args) {
+	return (int)myMalloc(args[0]);
+}
+
+/* myFreeErrorCode does its own, stricter, checking of the pointer */
+static int svc_free(uint32_t *args) {
+	return myFreeErrorCode((void *)args[0]);
+}
+
+static int svc_dir_ls(uint32_t *args) {
+	return dir_ls();
+}
+
+static int svc_memstat(uint32_t *args) {
+	return myMemstat((struct mem_stats *)args[0]);
+}
+
+static int svc_stats_copy(uint32_t *args) {
+	struct svc_stats *stats = (struct svc_stats *)args[0];
+	for(int i = 0; i < SVC_COUNT; i++) {
+		stats[i] = svc_stats[i];
+	}
+	return E_SUCCESS;
+}
+
+/* io_submit returns at most IO_RING_ENTRIES, which is less than E_BLOCKED */
+static int svc_io_submit(uint32_t *args) {
+	return io_submit((struct io_ring *)args[0]);
+}
+
+static int svc_aio_read(uint32_t *args) {
+	return aio_submit(AIO_OP_READ, args[0], (char *)args[1], args[2], (uint32_t *)args[3]);
+}
+
+static int svc_aio_write(uint32_t *args) {
+	return aio_submit(AIO_OP_WRITE, args[0], (char *)args[1], args[2], (uint32_t *)args[3]);
+}
+
+static int svc_aio_status(uint32_t *args) {
+	return aio_status(args[0], (int *)args[1]);
+}
+
+static int svc_aio_wait(uint32_t *args) {
+	if(aio_wait(args[0])) {
+		return E_BLOCKED;
+	}
+	return aio_status(args[0], (int *)args[1]);
+}
+
+static int svc_sleep(uint32_t *args) {
+	proc_sleep_svc(args[0]);
+	return E_SUCCESS;
+}
+
+static int svc_alarm(uint32_t *args) {
+	proc_alarm(args[0], args[1]);
+	return E_SUCCESS;
+}
+
+static int svc_alarm_wait(uint32_t *args) {
+	if(proc_alarm_wait()) {
+		return E_BLOCKED;
+	}
+	uint32_t count = proc_alarm_collect();
+	if(count == 0) {
+		return E_NO_ALARM;
+	}
+	*(uint32_t *)args[0] = count;
+	return E_SUCCESS;
+}
+
+static int svc_clock(uint32_t *args) {
+	*(uint64_t *)args[0] = clock_us();
+	return E_SUCCESS;
+}
+
+static int svc_tmp_sync(uint32_t *args) {
+	return tmp_sync();
+}
+
+/* The size of the fds array depends on nfds, so it is checked here rather
+ * than through the table.  The streams are checked and the caller put to
+ * sleep with interrupts masked, so a device can't become ready in between
+ * without the caller seeing it. */
+static int svc_poll(uint32_t *args) {
+	struct poll_fd *fds = (struct poll_fd *)args[0];
+	int nfds = args[1];
+	if(nfds < 0 || nfds > MAX_STREAMS ||
+	   !svc_user_range_valid((uint32_t)fds, nfds * sizeof(struct poll_fd))) {
+		return E_ADDR_SPC;
+	}
+	uint32_t primask = proc_irq_save();
+	int nready;
+	int status = mypoll(fds, nfds, &nready);
+	if(status == E_SUCCESS && nready == 0 && proc_poll_block(args[2])) {
+		proc_irq_restore(primask);
+		return E_BLOCKED;
+	}
+	proc_poll_done();
+	proc_irq_restore(primask);
+	if(status == E_SUCCESS) {
+		*(int *)args[3] = nready;
+	}
+	return status;
+}
+
+static const struct svc_entry svc_table[SVC_COUNT] = {
+	[SVC_FGETC] = {svc_fgetc, 4, SVC_PTR(1) | SVC_PTR(3), 0, 2, {0, 0, 0, sizeof(int)}, SVC_FS},
+	[SVC_FPUTC] = {svc_fputc, 3, SVC_PTR(0) | SVC_PTR(1), SVC_PTR(1), 2, {sizeof(file_descriptor), 0}, SVC_FS},
+	[SVC_FCLOSE] = {svc_fclose, 1, SVC_PTR(0), 0, -1, {sizeof(file_descriptor)}, SVC_FS},
+	[SVC_FCREATE] = {svc_fcreate, 1, SVC_PTR(0), SVC_PTR(0), -1, {SVC_STR}, SVC_FS},
+	[SVC_FDELETE] = {svc_fdelete, 1, SVC_PTR(0), SVC_PTR(0), -1, {SVC_STR}, SVC_FS},
+	[SVC_FOPEN] = {svc_fopen, 2, SVC_PTR(0) | SVC_PTR(1), SVC_PTR(0), -1, {SVC_STR, sizeof(file_descriptor)}, SVC_FS},
+	[SVC_MALLOC] = {svc_malloc, 1, 0, 0, -1, {0}},
+	[SVC_FREE] = {svc_free, 1, 0, 0, -1, {0}},
+	[SVC_DIR_LS] = {svc_dir_ls, 0, 0, 0, -1, {0}, SVC_FS},
+	[SVC_MEMSTAT] = {svc_memstat, 1, SVC_PTR(0), 0, -1, {sizeof(struct mem_stats)}},
+	[SVC_STATS] = {svc_stats_copy, 1, SVC_PTR(0), 0, -1, {sizeof(struct svc_stats) * SVC_COUNT}},
+	[SVC_IO_SUBMIT] = {svc_io_submit, 1, SVC_PTR(0), 0, -1, {sizeof(struct io_ring)}, SVC_FS},
+	[SVC_AIO_READ] = {svc_aio_read, 4, SVC_PTR(1) | SVC_PTR(3), 0, 2, {0, 0, 0, sizeof(uint32_t)}},
+	[SVC_AIO_WRITE] = {svc_aio_write, 4, SVC_PTR(1) | SVC_PTR(3), SVC_PTR(1), 2, {0, 0, 0, sizeof(uint32_t)}},
+	[SVC_AIO_STATUS] = {svc_aio_status, 2, SVC_PTR(1), 0, -1, {0, sizeof(int)}},
+	[SVC_AIO_WAIT] = {svc_aio_wait, 2, SVC_PTR(1), 0, -1, {0, sizeof(int)}},
+	[SVC_SLEEP] = {svc_sleep, 1, 0, 0, -1, {0}},
+	[SVC_ALARM] = {svc_alarm, 2, 0, 0, -1, {0}},
+	[SVC_ALARM_WAIT] = {svc_alarm_wait, 1, SVC_PTR(0), 0, -1, {sizeof(uint32_t)}},
+	[SVC_CLOCK] = {svc_clock, 1, SVC_PTR(0), 0, -1, {sizeof(uint64_t)}},
+	[SVC_TMP_SYNC] = {svc_tmp_sync, 0, 0, 0, -1, {0}, SVC_FS},
+	[SVC_POLL] = {svc_poll, 4, SVC_PTR(3), 0, -1, {0, 0, 0, sizeof(int)}},
+};
+
+/* Returns the number of bytes from addr to the end of the memory the
+ * calling process owns there: its own stack, or an object it allocated from
+ * the heap.  Returns 0 if it owns none of the memory at addr. */
+static uint32_t svc_user_bytes(uint32_t addr) {
+	uint32_t stack = (uint32_t)currentPCB->stack;
+	if(addr >= stack && addr < stack + currentPCB->stack_size) {
+		return stack + currentPCB->stack_size - addr;
+	}
+	return heapOwnedBytes((void *)addr, currentPCB->pid);
+}
+
+/* Ends of the code and constants in flash and of .data and .bss, from the
+ * linker script */
+extern char __etext[];
+extern char __data_start__[];
+extern char __bss_end__[];
+
+/* Returns the number of bytes from addr to the end of the program's code
+ * and constants in flash, or of its static data, whichever addr is in.
+ * Returns 0 if it is in neither. */
+static uint32_t svc_static_bytes(uint32_t addr) {
+	if(addr != 0 && addr < (uint32_t)__etext) {
+		return (uint32_t)__etext - addr;
+	}
+	if(addr >= (uint32_t)__data_start__ && addr < (uint32_t)__bss_end__) {
+		return (uint32_t)__bss_end__ - addr;
+	}
+	return 0;
+}
+
+/* The boot context has no process stack of its own and is trusted. */
+static int svc_trusted(void) {
+	return currentPCB == NULL || currentPCB->stack == NULL;
+}
+
+int svc_user_range_valid(uint32_t addr, uint32_t len) {
+	return svc_trusted() || len <= svc_user_bytes(addr);
+}
+
+int svc_user_input_valid(uint32_t addr, uint32_t len) {
+	return svc_user_range_valid(addr, len) || len <= svc_static_bytes(addr);
+}
+
+int svc_user_string_valid(const char *s) {
+	if(svc_trusted()) {
+		return 1;
+	}
+	uint32_t owned = svc_user_bytes((uint32_t)s);
+	if(owned == 0) {
+		owned = svc_static_bytes((uint32_t)s);
+	}
+	return owned > 0 && strnlen(s, owned) < owned;
+}
+
+static int svc_args_valid(const struct svc_entry *entry, uint32_t *args) {
+	for(int i = 0; i < entry->nargs; i++) {
+		if(!(entry->ptr_mask & SVC_PTR(i))) {
+			continue;
+		}
+		uint32_t len = entry->ptr_size[i];
+		if(len == SVC_STR) {
+			if(!svc_user_string_valid((const char *)args[i])) {
+				return 0;
+			}
+			continue;
+		}
+		if(len == 0) {
+			len = args[entry->len_arg];
+		}
+		if(entry->in_mask & SVC_PTR(i)) {
+			if(!svc_user_input_valid(args[i], len)) {
+				return 0;
+			}
+		} else if(!svc_user_range_valid(args[i], len)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
 void svcHandlerInC(struct frame *framePtr) {
+	uint32_t start = dwt_cycles();
 	/* framePtr->returnAddr is the return address for the SVC interrupt
 	 * service routine.  ((unsigned char *)framePtr->returnAddr)[-2]
 	 * is the operand specified for the SVC instruction. */
-	switch(((unsigned char *)framePtr->returnAddr)[-2]) {
-	case SVC_FOPEN:
-		framePtr->returnVal = myfopen((char *)framePtr->arg0, (file_descriptor*) framePtr->arg1);
-		break;
-	case SVC_FDELETE:
-		framePtr->returnVal = myfdelete((char *)framePtr->arg0);
-		break;
-	case SVC_FCREATE:
-		framePtr->returnVal = myfcreate((char *)framePtr->arg0);
-		break;
-	case SVC_FCLOSE:
-		framePtr->returnVal = myfclose((file_descriptor *)framePtr->arg0);
-		break;
-	case SVC_FPUTC:
-		framePtr->returnVal = myfputc((file_descriptor*) framePtr->arg0,
-									  (char *)framePtr->arg1, framePtr->arg2);
-		break;
-	case SVC_FGETC:
-		framePtr->returnVal = myfgetc(framePtr->arg0,
-				(char*)framePtr->arg1, framePtr->arg2, (int*)framePtr->arg3);
-		break;
-	case SVC_MALLOC:
-		framePtr->returnVal = myMalloc(framePtr->arg0);
-		break;
-	case SVC_FREE:
-		framePtr->returnVal = myFreeErrorCode((void*)framePtr->arg0);
-		break;
-	case SVC_DIR_LS:
-		framePtr->returnVal = dir_ls();
-		break;
-	default:
-		printf("Unknown SVC has been called\n");
+	unsigned char svc = ((unsigned char *)framePtr->returnAddr)[-2];
+	if(svc >= SVC_COUNT || svc_table[svc].handler == NULL) {
+		framePtr->returnVal = E_NOT_SUPPORTED;
+		return;
+	}
+	const struct svc_entry *entry = &svc_table[svc];
+	uint32_t *args = (uint32_t *)&framePtr->arg0;
+	uint32_t block[SVC_MAX_ARGS];
+	if(entry->nargs > SVC_REG_ARGS) {
+		if(!svc_user_range_valid(framePtr->arg0, entry->nargs * sizeof(uint32_t))) {
+			framePtr->returnVal = E_ADDR_SPC;
+			return;
+		}
+		/* Copy the block so the caller can't change it after it is checked */
+		for(int i = 0; i < entry->nargs; i++) {
+			block[i] = ((uint32_t *)framePtr->arg0)[i];
+		}
+		args = block;
+	}
+	int result;
+	if(!svc_args_valid(entry, args)) {
+		result = E_ADDR_SPC;
+	} else if((entry->flags & SVC_FS) && aio_fs_wait()) {
+		result = E_BLOCKED;
+	} else {
+		result = entry->handler(args);
+	}
+	if(result == E_BLOCKED) {
+		/* Back up over the 16-bit SVC instruction */
+		framePtr->returnAddr -= 2;
+		return;
 	}
+	framePtr->returnVal = result;
+	svc_stats[svc].calls++;
+	svc_stats[svc].cycles += dwt_cycles() - start;
+	svc_total_calls++;
 }
@@ -16,6 +16,8 @@
 
 #include <stdlib.h>
 #include "devinio.h"
+#include "my-malloc.h"
+#include "ioring.h"
 
 #define SVC_MaxPriority 15
 #define SVC_PriorityShift 4
@@ -31,6 +33,52 @@
 #define SVC_MALLOC 6
 #define SVC_FREE 7
 #define SVC_DIR_LS 8
+#define SVC_MEMSTAT 9
+#define SVC_STATS 10
+#define SVC_IO_SUBMIT 11
+#define SVC_AIO_READ 12
+#define SVC_AIO_WRITE 13
+#define SVC_AIO_STATUS 14
+#define SVC_AIO_WAIT 15
+#define SVC_SLEEP 16
+#define SVC_ALARM 17
+#define SVC_ALARM_WAIT 18
+#define SVC_CLOCK 19
+#define SVC_TMP_SYNC 20
+#define SVC_POLL 21
+
+// Number of SVC numbers above; must follow the last one
+#define SVC_COUNT 22
+
+/* An SVC with more than SVC_REG_ARGS arguments is passed a pointer in R0
+ * to a block of its (up to SVC_MAX_ARGS) 32-bit arguments instead */
+#define SVC_REG_ARGS 4
+#define SVC_MAX_ARGS 8
+
+/* Per SVC call count and the total core cycles spent in its handler */
+struct svc_stats {
+	uint32_t calls;
+	uint64_t cycles;
+};
+
+extern struct svc_stats svc_stats[SVC_COUNT];
+
+/* Total number of SVCs dispatched */
+extern uint32_t svc_total_calls;
+
+/* Returns true if the calling process owns [addr, addr+len) and may pass it
+ * to the kernel: it must lie within the process's stack or within a single
+ * heap object the process allocated */
+int svc_user_range_valid(uint32_t addr, uint32_t len);
+
+/* Returns true if the calling process may pass [addr, addr+len) to the
+ * kernel to be read: as for svc_user_range_valid, or it may lie within the
+ * program's constants in flash or its static data */
+int svc_user_input_valid(uint32_t addr, uint32_t len);
+
+/* Returns true if the calling process may pass the whole of the null
+ * terminated string s, terminator included, as for svc_user_input_valid */
+int svc_user_string_valid(const char *s);
 
 void svcInit_SetSVCPriority(unsigned char priority);
 void svcHandler(void);
@@ -44,5 +92,18 @@ int SVCMyfputc(file_descriptor *arg0, char *arg1, int arg2);
 void *SVCMymalloc(uint32_t arg0);
 int SVCMyfree(void *arg0);
 int SVCMydir_ls(void);
+int SVCMymemstat(struct mem_stats *arg0);
+int SVCMysvcstats(struct svc_stats *arg0);
+int SVCMyio_submit(struct io_ring *arg0);
+int SVCMyaio_read(file_descriptor arg0, char *arg1, int arg2, uint32_t *arg3);
+int SVCMyaio_write(file_descriptor arg0, char *arg1, int arg2, uint32_t *arg3);
+int SVCMyaio_status(uint32_t arg0, int *arg1);
+int SVCMyaio_wait(uint32_t arg0, int *arg1);
+int SVCMysleep(uint32_t arg0);
+int SVCMyalarm(uint32_t arg0, uint32_t arg1);
+int SVCMyalarm_wait(uint32_t *arg0);
+int SVCMyclock(uint64_t *arg0);
+int SVCMytmp_sync(void);
+int SVCMypoll(struct poll_fd *arg0, int arg1, int arg2, int *arg3);
 
 #endif /* ifndef _SVC_H */
@@ -0,0 +1,157 @@
+/**
+ * timer.c
+ * Hierarchical timer wheel
+ *
+ * Author: James Nicholson
+ */
+
+#include "timer.h"
+#include <stddef.h>
+
+/**
+ * Implementation Notes
+ *
+ * A timer due within TIMER_SLOTS ticks sits in the level 0 slot for its
+ * exact tick. One due later sits in the coarser slot of the lowest level
+ * that can reach it, and is moved down ("cascaded") a level each time the
+ * wheel below wraps around to the slot it belongs in. Adding and cancelling
+ * are O(1), and each tick touches one level 0 slot plus, once every
+ * TIMER_SLOTS ticks, one slot of each level that wrapped. A timer is
+ * cascaded at most TIMER_LEVELS - 1 times in its life.
+ *
+ * Slots are singly linked lists; each timer also keeps the address of the
+ * link pointing at it, so it can unlink itself without a search.
+ */
+
+#define TIMER_SLOT_MASK (TIMER_SLOTS - 1)
+
+void timer_wheel_init(struct timer_wheel *w)
+{
+    w->now = 0;
+    for (int level = 0; level < TIMER_LEVELS; level++)
+    {
+        for (int slot = 0; slot < TIMER_SLOTS; slot++)
+        {
+            w->slots[level][slot] = NULL;
+        }
+    }
+}
+
+void timer_init(struct timer *t, void (*callback)(struct timer *t), void *arg)
+{
+    t->next = NULL;
+    t->pprev = NULL;
+    t->expires = 0;
+    t->callback = callback;
+    t->arg = arg;
+}
+
+/**
+ * Link t into the slot for t->expires. A timer due now goes in the level 0
+ * slot about to be run.
+ */
+static void place(struct timer_wheel *w, struct timer *t)
+{
+    uint32_t delta = t->expires - w->now;
+    if ((int32_t)delta < 0)
+    {
+        delta = 0;
+        t->expires = w->now;
+    }
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= (1u << (TIMER_LEVEL_BITS * (level + 1))))
+    {
+        level++;
+    }
+    struct timer **slot = &w->slots[level][(t->expires >> (TIMER_LEVEL_BITS * level)) & TIMER_SLOT_MASK];
+    t->next = *slot;
+    if (t->next != NULL)
+    {
+        t->next->pprev = &t->next;
+    }
+    t->pprev = slot;
+    *slot = t;
+}
+
+void timer_cancel(struct timer *t)
+{
+    if (t->pprev == NULL)
+    {
+        return;
+    }
+    *t->pprev = t->next;
+    if (t->next != NULL)
+    {
+        t->next->pprev = t->pprev;
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+void timer_add(struct timer_wheel *w, struct timer *t, uint32_t expires)
+{
+    timer_cancel(t);
+    uint32_t delta = expires - w->now;
+    if ((int32_t)delta <= 0)
+    {
+        delta = 1;
+    }
+    else if (delta > TIMER_MAX_DELTA)
+    {
+        delta = TIMER_MAX_DELTA;
+    }
+    t->expires = w->now + delta;
+    place(w, t);
+}
+
+int timer_pending(struct timer *t)
+{
+    return t->pprev != NULL;
+}
+
+/**
+ * Re-place every timer in a slot of level, now that the level below has
+ * wrapped around to it.
+ */
+static void cascade(struct timer_wheel *w, int level)
+{
+    struct timer **slot = &w->slots[level][(w->now >> (TIMER_LEVEL_BITS * level)) & TIMER_SLOT_MASK];
+    struct timer *t = *slot;
+    *slot = NULL;
+    while (t != NULL)
+    {
+        struct timer *next = t->next;
+        place(w, t);
+        t = next;
+    }
+}
+
+void timer_wheel_tick(struct timer_wheel *w)
+{
+    w->now++;
+    // Cascade the highest level that wrapped first, so that its timers can
+    // fall all the way down to level 0 if they are due this tick.
+    int wrapped = 0;
+    while (wrapped < TIMER_LEVELS - 1 &&
+           ((w->now >> (TIMER_LEVEL_BITS * wrapped)) & TIMER_SLOT_MASK) == 0)
+    {
+        wrapped++;
+    }
+    for (int level = wrapped; level > 0; level--)
+    {
+        cascade(w, level);
+    }
+    struct timer **slot = &w->slots[0][w->now & TIMER_SLOT_MASK];
+    while (*slot != NULL)
+    {
+        struct timer *t = *slot;
+        *slot = t->next;
+        if (t->next != NULL)
+        {
+            t->next->pprev = slot;
+        }
+        t->next = NULL;
+        t->pprev = NULL;
+        t->callback(t);
+    }
+}
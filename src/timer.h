@@ -0,0 +1,73 @@
+/**
+ * timer.h
+ * Hierarchical timer wheel
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include <stdint.h>
+
+/**
+ * The wheel has TIMER_LEVELS levels of TIMER_SLOTS slots each. Level n
+ * slots are TIMER_SLOTS^n ticks wide, so timers up to
+ * TIMER_SLOTS^TIMER_LEVELS - 1 ticks ahead (about 4.6 hours at 1 kHz) are
+ * placed directly; later ones are clamped to that.
+ */
+#define TIMER_LEVEL_BITS 6
+#define TIMER_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_LEVELS 4
+#define TIMER_MAX_DELTA ((1u << (TIMER_LEVEL_BITS * TIMER_LEVELS)) - 1)
+
+struct timer
+{
+    struct timer *next;
+    struct timer **pprev; // link that points at this timer, NULL if not pending
+    uint32_t expires; // tick at which callback runs
+    void (*callback)(struct timer *t);
+    void *arg; // for the callback's use
+};
+
+/**
+ * Like the scheduler, the wheel does not touch hardware: the caller feeds it
+ * ticks, so it can be tested against a simulated tick.
+ */
+struct timer_wheel
+{
+    uint32_t now; // ticks since timer_wheel_init
+    struct timer *slots[TIMER_LEVELS][TIMER_SLOTS];
+};
+
+void timer_wheel_init(struct timer_wheel *w);
+
+/**
+ * Initialize t so that it calls callback(t) when it expires. t is not
+ * pending until it is added.
+ */
+void timer_init(struct timer *t, void (*callback)(struct timer *t), void *arg);
+
+/**
+ * Arrange for t to expire at tick expires, or on the next tick if that has
+ * already passed. If t is already pending it is moved. O(1).
+ */
+void timer_add(struct timer_wheel *w, struct timer *t, uint32_t expires);
+
+/**
+ * Stop t if it is pending. O(1).
+ */
+void timer_cancel(struct timer *t);
+
+/**
+ * Returns: 1 if t has been added and has not yet expired or been cancelled
+ */
+int timer_pending(struct timer *t);
+
+/**
+ * Advance the wheel by one tick and run the callbacks of the timers that
+ * expire on it. A callback may add timers, including its own.
+ */
+void timer_wheel_tick(struct timer_wheel *w);
+
+#endif /* ifndef _TIMER_H */
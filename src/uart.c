@@ -1,6 +1,6 @@
 /**
  * uart.c
- * UART routines for polled serial I/O
+ * UART routines for serial I/O, interrupt driven on UART2
  *
  * ARM-based K70F120M microcontroller board
  *   for educational purposes only
@@ -12,8 +12,30 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include "derivative.h"
 #include "uart.h"
+#include "nvic.h"
+#include "waitq.h"
+#include "ringbuf.h"
+
+/* UART2 receive and transmit rings and the processes waiting on them */
+static uint8_t uart2RxStorage[UART2_RX_BUFFER_SIZE];
+static uint8_t uart2TxStorage[UART2_TX_BUFFER_SIZE];
+static struct ringbuf uart2Rx;
+static struct ringbuf uart2Tx;
+static struct wait_queue uart2RxWait = WAIT_QUEUE_INIT;
+static struct wait_queue uart2TxWait = WAIT_QUEUE_INIT;
+
+/* Characters received on UART2 while its Rx ring was full */
+uint32_t uart2RxDropped = 0;
+
+/* Large writes to UART2 are copied here and sent by eDMA.  While a DMA
+ * transfer is active, UART2's Tx requests go to the DMA controller
+ * instead of uart2StatusHandler; output queued in the Tx ring meanwhile
+ * is started when the transfer completes. */
+static uint8_t uart2DmaBuffer[UART2_DMA_BUFFER_SIZE];
+static volatile int uart2DmaActive = 0;
 
 /* Chapter 56 Universal Asynchronous Receiver/Transmitter (UART) on
  * labeled page 1891 (PDF page 1898) of the K70 Sub-Family Reference
@@ -34,8 +56,9 @@
 
 /********************************************************************/
 /*
- * Initialize the specified UART in 8-N-1 mode with interrupts disabled
- * and with no hardware flow-control
+ * Initialize the specified UART in 8-N-1 mode with no hardware
+ * flow-control.  Interrupts are disabled except on UART2, whose receive
+ * interrupt is enabled
  *
  * Note: This routine *does* enable the appropriate UART and PORT clocks
  *
@@ -175,6 +198,255 @@ void uartInit(UART_MemMapPtr uartChannel, int clockInKHz, int baud) {
 
     /* Enable receiver and transmitter */
     UART_C2_REG(uartChannel) |= (UART_C2_TE_MASK | UART_C2_RE_MASK );
+
+    /* UART2 is the console and is interrupt driven: received characters
+     * are queued by uart2StatusHandler as they arrive, and output is
+     * queued by uartPutchar and drained by the handler. */
+    if(uartChannel == UART2_BASE_PTR) {
+    	ringbuf_init(&uart2Rx, uart2RxStorage, UART2_RX_BUFFER_SIZE);
+    	ringbuf_init(&uart2Tx, uart2TxStorage, UART2_TX_BUFFER_SIZE);
+    	UART_C2_REG(uartChannel) |= UART_C2_RIE_MASK;
+    	nvic_enable_irq(UART2_STATUS_IRQ_NUMBER, UART2_STATUS_INTERRUPT_PRIORITY);
+
+    	/* Route the UART2 transmit DMA request to the Tx DMA channel */
+    	SIM_SCGC6 |= SIM_SCGC6_DMAMUX0_MASK;
+    	SIM_SCGC7 |= SIM_SCGC7_DMA_MASK;
+    	DMAMUX0_CHCFG0 = 0;
+    	DMAMUX0_CHCFG0 = DMAMUX_CHCFG_ENBL_MASK |
+    	    DMAMUX_CHCFG_SOURCE(UART2_TX_DMAMUX_SOURCE);
+    	nvic_enable_irq(UART2_TX_DMA_IRQ_NUMBER, UART2_TX_DMA_INTERRUPT_PRIORITY);
+    }
+}
+
+/********************************************************************/
+/*
+ * Move received characters from the UART2 receiver into the Rx ring
+ *
+ * Called by the interrupt handler, and with interrupts masked by code
+ * that cannot wait for the handler.  Reading S1 and then D clears RDRF
+ * and any overrun.
+ */
+static void uart2Receive(void) {
+    while(UART_S1_REG(UART2_BASE_PTR) & (UART_S1_RDRF_MASK | UART_S1_OR_MASK)) {
+    	uint8_t c = UART_D_REG(UART2_BASE_PTR);
+    	if(!ringbuf_put(&uart2Rx, c)) {
+    		uart2RxDropped++;
+    	}
+    }
+}
+
+/********************************************************************/
+/*
+ * Move queued characters from the Tx ring into the UART2 transmitter
+ * while it has room, and stop asking for Tx interrupts once the ring is
+ * empty.  Same calling rules as uart2Receive.
+ */
+static void uart2Transmit(void) {
+    uint8_t c;
+    while((UART_S1_REG(UART2_BASE_PTR) & UART_S1_TDRE_MASK) &&
+          ringbuf_get(&uart2Tx, &c)) {
+    	UART_D_REG(UART2_BASE_PTR) = c;
+    }
+    if(ringbuf_count(&uart2Tx) == 0) {
+    	UART_C2_REG(UART2_BASE_PTR) &= ~UART_C2_TIE_MASK;
+    }
+}
+
+/********************************************************************/
+/*
+ * UART2 status interrupt handler
+ */
+void uart2StatusHandler(void) {
+    uint32_t received = ringbuf_count(&uart2Rx);
+    uart2Receive();
+    if(ringbuf_count(&uart2Rx) != received) {
+    	waitq_wake_all(&uart2RxWait);
+    	proc_poll_wake();
+    }
+    if(!uart2DmaActive && (UART_C2_REG(UART2_BASE_PTR) & UART_C2_TIE_MASK)) {
+    	uint32_t space = ringbuf_space(&uart2Tx);
+    	uart2Transmit();
+    	if(ringbuf_space(&uart2Tx) != space) {
+    		waitq_wake_all(&uart2TxWait);
+    	}
+    }
+}
+
+/********************************************************************/
+/*
+ * Start sending the first len bytes of uart2DmaBuffer by eDMA
+ *
+ * One byte moves to UART2_D per Tx DMA request (i.e., whenever the
+ * transmitter has room); the channel raises its interrupt and disables
+ * its own request after the last byte.
+ */
+static void uart2DmaStart(int len) {
+    DMA_TCD0_SADDR = (uint32_t)uart2DmaBuffer;
+    DMA_TCD0_SOFF = 1;
+    DMA_TCD0_ATTR = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0);
+    DMA_TCD0_NBYTES_MLNO = 1;
+    DMA_TCD0_SLAST = 0;
+    DMA_TCD0_DADDR = (uint32_t)&UART_D_REG(UART2_BASE_PTR);
+    DMA_TCD0_DOFF = 0;
+    DMA_TCD0_CITER_ELINKNO = DMA_CITER_ELINKNO_CITER(len);
+    DMA_TCD0_BITER_ELINKNO = DMA_BITER_ELINKNO_BITER(len);
+    DMA_TCD0_DLASTSGA = 0;
+    DMA_TCD0_CSR = DMA_CSR_INTMAJOR_MASK | DMA_CSR_DREQ_MASK;
+    uart2DmaActive = 1;
+    UART_C5_REG(UART2_BASE_PTR) |= UART_C5_TDMAS_MASK;
+    UART_C2_REG(UART2_BASE_PTR) |= UART_C2_TIE_MASK;
+    DMA_SERQ = UART2_TX_DMA_CHANNEL;
+}
+
+/********************************************************************/
+/*
+ * Finish a UART2 DMA transfer and hand the transmitter back to the Tx
+ * ring.  Called from the DMA interrupt, or with interrupts masked.
+ */
+static void uart2DmaComplete(void) {
+    DMA_CINT = UART2_TX_DMA_CHANNEL;
+    DMA_CDNE = UART2_TX_DMA_CHANNEL;
+    UART_C5_REG(UART2_BASE_PTR) &= ~UART_C5_TDMAS_MASK;
+    uart2DmaActive = 0;
+    if(ringbuf_count(&uart2Tx) != 0) {
+    	UART_C2_REG(UART2_BASE_PTR) |= UART_C2_TIE_MASK;
+    } else {
+    	UART_C2_REG(UART2_BASE_PTR) &= ~UART_C2_TIE_MASK;
+    }
+}
+
+/********************************************************************/
+/*
+ * Complete a finished DMA transfer without waiting for its interrupt,
+ * for callers that cannot sleep.  Called with interrupts masked.
+ */
+static void uart2DmaPoll(void) {
+    if(uart2DmaActive && (DMA_TCD0_CSR & DMA_CSR_DONE_MASK)) {
+    	uart2DmaComplete();
+    }
+}
+
+/********************************************************************/
+/*
+ * UART2 transmit DMA channel interrupt handler
+ */
+void uart2TxDmaHandler(void) {
+    uart2DmaComplete();
+    waitq_wake_all(&uart2TxWait);
+}
+
+/********************************************************************/
+/*
+ * WAIT_EVENT condition: take a character from the Rx ring into *c
+ *
+ * The Rx ring has one consumer at a time because interrupts are masked.
+ * When the caller cannot sleep it may be running in a handler that the
+ * UART interrupt cannot preempt, so it polls the receiver itself.
+ */
+static int uart2RxTake(char *c) {
+    uint32_t primask = proc_irq_save();
+    if(!proc_can_block()) {
+    	uart2Receive();
+    }
+    int taken = ringbuf_get(&uart2Rx, (uint8_t *)c);
+    proc_irq_restore(primask);
+    return taken;
+}
+
+/********************************************************************/
+/*
+ * WAIT_EVENT condition: append up to len characters from *p to the Tx ring
+ * and advance *p and *len past them
+ *
+ * Returns true once everything is queued.  Like uart2RxTake, a caller
+ * that cannot sleep drains the transmitter itself.
+ */
+static int uart2TxQueue(const char **p, int *len) {
+    uint32_t primask = proc_irq_save();
+    if(!proc_can_block()) {
+    	uart2DmaPoll();
+    	if(!uart2DmaActive) {
+    		uart2Transmit();
+    	}
+    }
+    int queued = ringbuf_write(&uart2Tx, (const uint8_t *)*p, *len);
+    *p += queued;
+    *len -= queued;
+    if(queued > 0 && !uart2DmaActive) {
+    	UART_C2_REG(UART2_BASE_PTR) |= UART_C2_TIE_MASK;
+    }
+    proc_irq_restore(primask);
+    return *len == 0;
+}
+
+/********************************************************************/
+/*
+ * WAIT_EVENT condition: once the Tx ring is empty and no DMA transfer is
+ * active, copy the next chunk of *p into the DMA buffer (expanding \n to
+ * \r\n if nl is set), start sending it and advance *p and *len past it
+ *
+ * Returns true once everything has been handed to the DMA controller.
+ */
+static int uart2DmaQueue(const char **p, int *len, int nl) {
+    uint32_t primask = proc_irq_save();
+    if(!proc_can_block()) {
+    	uart2DmaPoll();
+    	if(!uart2DmaActive) {
+    		uart2Transmit();
+    	}
+    }
+    if(!uart2DmaActive && ringbuf_count(&uart2Tx) == 0) {
+    	int n = 0;
+    	/* Stop one short so that a \r\n pair always fits */
+    	while(*len > 0 && n < UART2_DMA_BUFFER_SIZE - 1) {
+    		char c = **p;
+    		if(nl && c == '\n') {
+    			uart2DmaBuffer[n++] = '\r';
+    		}
+    		uart2DmaBuffer[n++] = c;
+    		(*p)++;
+    		(*len)--;
+    	}
+    	if(n > 0) {
+    		uart2DmaStart(n);
+    	}
+    }
+    proc_irq_restore(primask);
+    return *len == 0;
+}
+
+/********************************************************************/
+/*
+ * Queue len characters from p for output on UART2, expanding \n to \r\n
+ * if nl is set
+ *
+ * Writes of at least UART2_DMA_THRESHOLD characters are sent by DMA;
+ * shorter ones go through the Tx ring and the status interrupt.
+ */
+static void uart2Send(const char *p, int len, int nl) {
+    if(len >= UART2_DMA_THRESHOLD) {
+    	WAIT_EVENT(&uart2TxWait, uart2DmaQueue(&p, &len, nl));
+    	return;
+    }
+    while(len > 0) {
+    	int segment = len;
+    	if(nl) {
+    		const char *newline = memchr(p, '\n', len);
+    		if(newline != NULL) {
+    			segment = newline - p;
+    		}
+    	}
+    	len -= segment;
+    	WAIT_EVENT(&uart2TxWait, uart2TxQueue(&p, &segment));
+    	if(len > 0) {
+    		/* p is at a new-line */
+    		const char *crlf = "\r\n";
+    		int crlfLen = 2;
+    		WAIT_EVENT(&uart2TxWait, uart2TxQueue(&crlf, &crlfLen));
+    		p++;
+    		len--;
+    	}
+    }
 }
 
 /********************************************************************/
@@ -188,6 +460,12 @@ void uartInit(UART_MemMapPtr uartChannel, int clockInKHz, int baud) {
  *  the received character
  */
 char uartGetchar(UART_MemMapPtr uartChannel) {
+    if(uartChannel == UART2_BASE_PTR) {
+    	char c;
+    	WAIT_EVENT(&uart2RxWait, uart2RxTake(&c));
+    	return c;
+    }
+
     /* Wait until character has been received */
     while(!(UART_S1_REG(uartChannel) & UART_S1_RDRF_MASK)) {
     }
@@ -196,6 +474,28 @@ char uartGetchar(UART_MemMapPtr uartChannel) {
     return UART_D_REG(uartChannel);
 }
 
+/********************************************************************/
+/*
+ * Take a received character from UART2 for device code that may be
+ * running in the SVC handler
+ *
+ * There the calling process is put to sleep until a character arrives
+ * and E_BLOCKED is returned (see WAIT_EVENT_SVC); the SVC must then
+ * return E_BLOCKED to be run again once the process wakes.  Elsewhere
+ * this waits as uartGetchar does.
+ *
+ * Parameters:
+ *  c            set to the received character
+ *
+ * Return Values:
+ *  E_SUCCESS or E_BLOCKED
+ */
+int uart2GetcharSVC(char *c) {
+    int status;
+    WAIT_EVENT_SVC(&uart2RxWait, uart2RxTake(c), status);
+    return status;
+}
+
 /********************************************************************/
 /*
  * Wait for space in the specified UART Tx FIFO and then output a character
@@ -205,6 +505,11 @@ char uartGetchar(UART_MemMapPtr uartChannel) {
  *  ch           character to be output
  */
 void uartPutchar(UART_MemMapPtr uartChannel, char ch) {
+    if(uartChannel == UART2_BASE_PTR) {
+    	uartWrite(uartChannel, &ch, 1);
+    	return;
+    }
+
     /* Wait until space is available in the FIFO */
     while(!(UART_S1_REG(uartChannel) & UART_S1_TDRE_MASK)) {
     }
@@ -213,6 +518,51 @@ void uartPutchar(UART_MemMapPtr uartChannel, char ch) {
     UART_D_REG(uartChannel) = (uint8_t)ch;
 }
 
+/********************************************************************/
+/*
+ * Output len characters
+ *
+ * On UART2 this returns as soon as the characters are queued for the
+ * status interrupt or the DMA controller, sleeping only while there is
+ * no room for them.
+ *
+ * Parameters:
+ *  uartChannel  UART channel on which to output the characters
+ *  p            pointer to the characters to be output
+ *  len          number of characters to output
+ */
+void uartWrite(UART_MemMapPtr uartChannel, const char *p, int len) {
+    if(uartChannel == UART2_BASE_PTR) {
+    	uart2Send(p, len, 0);
+    	return;
+    }
+    while(len-- > 0) {
+    	uartPutchar(uartChannel, *p++);
+    }
+}
+
+/********************************************************************/
+/*
+ * Output len characters with each \n outputted as \r\n
+ *
+ * Parameters:
+ *  uartChannel  UART channel on which to output the characters
+ *  p            pointer to the characters to be output
+ *  len          number of characters to output
+ */
+void uartWriteNL(UART_MemMapPtr uartChannel, const char *p, int len) {
+    if(uartChannel == UART2_BASE_PTR) {
+    	uart2Send(p, len, 1);
+    	return;
+    }
+    while(len-- > 0) {
+    	if(*p == '\n') {
+    		uartPutchar(uartChannel, '\r');
+    	}
+    	uartPutchar(uartChannel, *p++);
+    }
+}
+
 /********************************************************************/
 /*
  * Check to see if a character has been received
@@ -225,6 +575,10 @@ void uartPutchar(UART_MemMapPtr uartChannel, char ch) {
  *  1            Character has been received
  */
 int uartGetcharPresent(UART_MemMapPtr uartChannel) {
+    if(uartChannel == UART2_BASE_PTR) {
+    	return ringbuf_count(&uart2Rx) != 0 ||
+    	    (UART_S1_REG(uartChannel) & UART_S1_RDRF_MASK) != 0;
+    }
     return (UART_S1_REG(uartChannel) & UART_S1_RDRF_MASK) != 0;
 }
 
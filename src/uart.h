@@ -1,6 +1,6 @@
 /**
  * uart.h
- * UART routines for polled serial I/O
+ * UART routines for serial I/O, interrupt driven on UART2
  * 
  * ARM-based K70F120M microcontroller board
  *   for educational purposes only
@@ -14,6 +14,7 @@
 #ifndef _UART_H
 #define _UART_H
 
+#include <stdint.h>
 #include "derivative.h"
 
 /* IRQs for UART status and error sources */
@@ -45,10 +46,34 @@
 #define UART5_STATUS_INTERRUPT_PRIORITY 7
 #define UART5_ERROR_INTERRUPT_PRIORITY 7
 
+/* Sizes of the UART2 receive and transmit rings (powers of two) */
+#define UART2_RX_BUFFER_SIZE 256
+#define UART2_TX_BUFFER_SIZE 2048
+
+/* UART2 writes of at least UART2_DMA_THRESHOLD characters are sent by eDMA
+ * from a staging buffer of UART2_DMA_BUFFER_SIZE bytes */
+#define UART2_DMA_THRESHOLD 64
+#define UART2_DMA_BUFFER_SIZE 4096
+
+/* eDMA channel, DMAMUX request source (UART2 Transmit), IRQ number and
+ * interrupt priority used for UART2 transmit */
+#define UART2_TX_DMA_CHANNEL 0
+#define UART2_TX_DMAMUX_SOURCE 7
+#define UART2_TX_DMA_IRQ_NUMBER 0
+#define UART2_TX_DMA_INTERRUPT_PRIORITY 7
+
+/* Characters received on UART2 while its Rx ring was full */
+extern uint32_t uart2RxDropped;
+
 void uartInit(UART_MemMapPtr uartChannel, int clockInKHz, int baud);
 char uartGetchar(UART_MemMapPtr uartChannel);
+int uart2GetcharSVC(char *c);
 void uartPutchar(UART_MemMapPtr uartChannel, char ch);
 int uartGetcharPresent(UART_MemMapPtr uartChannel);
 void uartPuts(UART_MemMapPtr uartChannel, char *p);
+void uartWrite(UART_MemMapPtr uartChannel, const char *p, int len);
+void uartWriteNL(UART_MemMapPtr uartChannel, const char *p, int len);
+void uart2StatusHandler(void);
+void uart2TxDmaHandler(void);
 
 #endif /* ifndef _UART_H */
@@ -14,6 +14,7 @@
  * Last updated: 3:28 PM 18-Mar-2021
  */
 
+#include <string.h>
 #include "uartNL.h"
 
 /********************************************************************/
@@ -81,16 +82,12 @@ void uartGetline(UART_MemMapPtr uartChannel, char *p, int size) {
 
 /********************************************************************/
 /*
- * Output a string using uartPutchar, but with \n outputted as \r\n
+ * Output a string using uartWriteNL, i.e. with \n outputted as \r\n
  *
  * Parameters:
  *  uartChannel  UART channel on which to output a string
  *  p            pointer to string to be output
  */ 
 void uartPutsNL(UART_MemMapPtr uartChannel, char *p) {
-  while(*p) {
-    if(*p == '\n')
-      uartPutchar(uartChannel, '\r');
-    uartPutchar(uartChannel, *p++);
-  }
+  uartWriteNL(uartChannel, p, strlen(p));
 }
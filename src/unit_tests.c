@@ -15,6 +15,9 @@
 #include "SDHC_FAT32_Files.h"
 #include "breakpoint.h"
 #include "utils.h"
+#include "svc.h"
+#include "ioring.h"
+#include "mySTDSTRMdriver.h"
 
 
 int debug = 0;
@@ -37,6 +40,288 @@ void test_create_file(void) {
     }
 }
 
+/**
+ * The tokenizer must split in place and the command table must find every
+ * command, and nothing else.
+ */
+void test_shell_dispatch(void) {
+    char *test_name = "Shell Dispatch";
+    char *result = "PASS";
+    char line[] = "  open\t/dev/pipe0   x\n";
+    char *argv[4];
+    int argc = -1;
+    if (shell_tokenize(line, argv, 3, &argc) != E_SUCCESS || argc != 3 || argv[3] != NULL ||
+        argv[0] != &line[2] || strcmp(argv[0], "open") != 0 || strcmp(argv[1], "/dev/pipe0") != 0 ||
+        strcmp(argv[2], "x") != 0) {
+        result = "FAIL";
+    }
+    char blank[] = " \t \n";
+    if (shell_tokenize(blank, argv, 3, &argc) != E_SUCCESS || argc != 0) {
+        result = "FAIL";
+    }
+    char many[] = "a b c d";
+    if (shell_tokenize(many, argv, 3, &argc) != E_TOO_MANY_ARGS) {
+        result = "FAIL";
+    }
+    if (cmd_table_init() != E_SUCCESS) {
+        result = "FAIL";
+    }
+    for (int i = 0; i < commands_count; i++) {
+        if (find_cmd(commands[i].name) != commands[i].functionp) {
+            result = "FAIL";
+        }
+    }
+    if (find_cmd("nope") != NULL || find_cmd("") != NULL || find_cmd("memoryma") != NULL) {
+        result = "FAIL";
+    }
+    if (debug == 1) {
+        myprintf("%s: %s\n\n", test_name, result);
+    }
+}
+
+/**
+ * Queue writes and a read on a file and wait for each. The suite runs in a
+ * process, so the waits block in the SVC and are restarted when the worker
+ * finishes, and the worker runs each request on its copy of this process's
+ * stream. The second write must land after the first, which it only does if
+ * the file position came back with the stream. A request still queued when
+ * its fd is closed is cancelled, unless the worker got to it first. Other
+ * devices are refused.
+ */
+void test_aio(void) {
+    char *test_name = "Async I/O";
+    char *result = "PASS";
+    char *path = "/AIOTEST.TXT";
+    char first[] = "0123456789";
+    char second[] = "abcdef";
+    char in[32];
+    file_descriptor fd;
+    uint32_t id;
+    int count = -1;
+    SVCMyfdelete(path);
+    if (SVCMyfcreate(path) != E_SUCCESS || SVCMyfopen(path, &fd) != E_SUCCESS) {
+        result = "FAIL";
+    } else {
+        if (SVCMyaio_write(fd, first, sizeof(first), &id) != E_SUCCESS ||
+            SVCMyaio_wait(id, &count) != E_SUCCESS) {
+            result = "FAIL";
+        }
+        if (SVCMyaio_write(fd, second, sizeof(second), &id) != E_SUCCESS ||
+            SVCMyaio_wait(id, &count) != E_SUCCESS) {
+            result = "FAIL";
+        }
+        // A collected id is released
+        if (SVCMyaio_status(id, &count) != E_AIO_ID) {
+            result = "FAIL";
+        }
+        SVCMyfclose(&fd);
+    }
+    if (SVCMyfopen(path, &fd) != E_SUCCESS) {
+        result = "FAIL";
+    } else {
+        memset(in, 0, sizeof(in));
+        if (SVCMyaio_read(fd, in, sizeof(in), &id) != E_SUCCESS ||
+            SVCMyaio_wait(id, &count) != E_SUCCESS ||
+            count != 16 || memcmp(in, "0123456789abcdef", 16) != 0) {
+            result = "FAIL";
+        }
+        SVCMyfclose(&fd);
+    }
+    // Closing the fd cancels a request the worker hasn't started
+    if (SVCMyfopen(path, &fd) != E_SUCCESS) {
+        result = "FAIL";
+    } else {
+        int status = SVCMyaio_write(fd, second, sizeof(second), &id);
+        SVCMyfclose(&fd);
+        if (status != E_SUCCESS) {
+            result = "FAIL";
+        } else {
+            status = SVCMyaio_wait(id, &count);
+            if (status != E_FILE_CLOSED && status != E_SUCCESS) {
+                result = "FAIL";
+            }
+        }
+    }
+    SVCMyfdelete(path);
+    if (SVCMyaio_read(STDIN_FD, in, sizeof(in), &id) != E_NOT_SUPPORTED) {
+        result = "FAIL";
+    }
+    if (debug == 1) {
+        myprintf("%s: %s\n\n", test_name, result);
+    }
+}
+
+/**
+ * A process may pass the kernel string literals and other constants to
+ * read, but not to write into.
+ */
+void test_svc_static_args(void) {
+    char *test_name = "SVC Static Arguments";
+    char *result = "PASS";
+    static const char literal_in[] = "0123";
+    file_descriptor fd;
+    int count;
+    SVCMyfdelete("/LITERAL.TXT");
+    if (SVCMyfcreate("/LITERAL.TXT") != E_SUCCESS || SVCMyfopen("/LITERAL.TXT", &fd) != E_SUCCESS) {
+        result = "FAIL";
+    } else {
+        if (SVCMyfputc(&fd, "abcd", sizeof("abcd")) != E_SUCCESS) {
+            result = "FAIL";
+        }
+        SVCMyfclose(&fd);
+        SVCMyfopen("/LITERAL.TXT", &fd);
+        if (SVCMyfgetc(fd, (char *)literal_in, 4, &count) != E_ADDR_SPC ||
+            memcmp(literal_in, "0123", 4) != 0) {
+            result = "FAIL";
+        }
+        SVCMyfclose(&fd);
+    }
+    if (SVCMyfdelete("/LITERAL.TXT") != E_SUCCESS) {
+        result = "FAIL";
+    }
+    if (debug == 1) {
+        myprintf("%s: %s\n\n", test_name, result);
+    }
+}
+
+/**
+ * Completions must come back in submission order, and consecutive writes to
+ * a file must be merged without losing any of them, even when one is cut
+ * short by a null before its end.
+ */
+void test_io_ring(void) {
+    char *test_name = "I/O Ring";
+    char *result = "PASS";
+    char path[] = "/IORING.TXT";
+    char short_write[] = "ab\0xx";
+    char write2[] = "cd";
+    char write3[] = "ef";
+    char in[16];
+    struct io_ring ring;
+    file_descriptor fd;
+    int count = -1;
+    SVCMyfdelete(path);
+    if (SVCMyfcreate(path) != E_SUCCESS || SVCMyfopen(path, &fd) != E_SUCCESS) {
+        result = "FAIL";
+    } else {
+        io_ring_init(&ring);
+        struct io_sqe *sqe = io_ring_get_sqe(&ring);
+        sqe->op = IO_OP_NOP;
+        sqe->user_data = 0;
+        char *bufs[3] = {short_write, write2, write3};
+        uint32_t lens[3] = {sizeof(short_write), sizeof(write2), sizeof(write3)};
+        for (int i = 0; i < 3; i++) {
+            sqe = io_ring_get_sqe(&ring);
+            sqe->op = IO_OP_WRITE;
+            sqe->fd = fd;
+            sqe->buf = bufs[i];
+            sqe->len = lens[i];
+            sqe->user_data = i + 1;
+        }
+        sqe = io_ring_get_sqe(&ring);
+        sqe->op = IO_OP_CLOSE;
+        sqe->fd = fd;
+        sqe->user_data = 4;
+        if (SVCMyio_submit(&ring) != 5) {
+            result = "FAIL";
+        }
+        for (uint32_t i = 0; i < 5; i++) {
+            struct io_cqe *cqe = io_ring_peek_cqe(&ring);
+            if (cqe == NULL || cqe->user_data != i || cqe->status != E_SUCCESS) {
+                result = "FAIL";
+                break;
+            }
+            io_ring_cqe_seen(&ring);
+        }
+        if (io_ring_peek_cqe(&ring) != NULL) {
+            result = "FAIL";
+        }
+    }
+    if (SVCMyfopen(path, &fd) != E_SUCCESS) {
+        result = "FAIL";
+    } else {
+        memset(in, 0, sizeof(in));
+        if (SVCMyfgetc(fd, in, sizeof(in), &count) != E_SUCCESS ||
+            count != 6 || memcmp(in, "abcdef", 6) != 0) {
+            result = "FAIL";
+        }
+        SVCMyfclose(&fd);
+    }
+    SVCMyfdelete(path);
+    if (debug == 1) {
+        myprintf("%s: %s\n\n", test_name, result);
+    }
+}
+
+#define SCRIPT_TEST_LINES 100
+
+/**
+ * Run a script several sectors long, each line of which appends a word to a
+ * file, then check that every word arrived, in order. The words span more
+ * than one sector of their file too.
+ */
+void test_run_script(void) {
+    char *test_name = "Run Script";
+    char *result = "PASS";
+    char script_path[] = "/SCRIPT.SH";
+    char out_path[] = "/SCRIPT.OUT";
+    char line[32];
+    char expected[SCRIPT_TEST_LINES * 8 + 1];
+    char in[sizeof(expected) + 100];
+    file_descriptor script_fd;
+    file_descriptor out_fd;
+    SVCMyfdelete(script_path);
+    SVCMyfdelete(out_path);
+    if (SVCMyfcreate(script_path) != E_SUCCESS || SVCMyfcreate(out_path) != E_SUCCESS ||
+        SVCMyfopen(out_path, &out_fd) != E_SUCCESS) {
+        result = "FAIL";
+    } else {
+        if (SVCMyfopen(script_path, &script_fd) != E_SUCCESS) {
+            result = "FAIL";
+        } else {
+            int expected_len = 0;
+            for (int i = 0; i < SCRIPT_TEST_LINES; i++) {
+                int len = snprintf(line, sizeof(line), "write %d line%03d\n", out_fd, i);
+                if (SVCMyfputc(&script_fd, line, len + 1) != E_SUCCESS) {
+                    result = "FAIL";
+                }
+                expected_len += snprintf(&expected[expected_len], sizeof(expected) - expected_len, "line%03d", i);
+            }
+            SVCMyfclose(&script_fd);
+            char *argv[1] = {script_path};
+            if (cmd_run(1, argv) != E_SUCCESS) {
+                result = "FAIL";
+            }
+            // Read the output back in pieces that straddle its sectors
+            int total = 0;
+            int count;
+            SVCMyfclose(&out_fd);
+            SVCMyfopen(out_path, &out_fd);
+            while (total + 100 <= sizeof(in) &&
+                   SVCMyfgetc(out_fd, &in[total], 100, &count) == E_SUCCESS && count > 0) {
+                total += count;
+            }
+            if (total != expected_len || memcmp(in, expected, expected_len) != 0) {
+                result = "FAIL";
+            }
+        }
+        SVCMyfclose(&out_fd);
+    }
+    SVCMyfdelete(script_path);
+    SVCMyfdelete(out_path);
+    if (debug == 1) {
+        myprintf("%s: %s\n\n", test_name, result);
+    }
+}
+
 void run_test_suite() {
     test_create_file();
+    test_shell_dispatch();
+}
+
+void run_process_test_suite(void) {
+    test_aio();
+    test_svc_static_args();
+    test_io_ring();
+    test_run_script();
 }
\ No newline at end of file
@@ -5,4 +5,10 @@
 
 void run_test_suite(void);
 
+/**
+ * Run the tests that need a running process. Called by the shell once it
+ * has started.
+ */
+void run_process_test_suite(void);
+
 #endif /* ifndef _UNITTESTS_H */
\ No newline at end of file
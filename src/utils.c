@@ -8,6 +8,9 @@
 #include "utils.h"
 #include "uart.h"
 #include "uartNL.h"
+#include "pcb.h"
+#include "devinio.h"
+#include "mySTDSTRMdriver.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
@@ -70,6 +73,14 @@ int myprintf(char *format, ...)
         return E_MYPRINTF;
     }
     va_end(args);
+    if (length >= sizeof(buffer)) {
+        length = sizeof(buffer) - 1;
+    }
+    // Write to stdout once the process has one; before that, straight to the console.
+    if (currentPCB != NULL && stream_get(currentPCB, STDOUT_FD)->in_use) {
+        file_descriptor fd = STDOUT_FD;
+        return myfputc(&fd, buffer, length);
+    }
     uartPutsNL(UART2_BASE_PTR, buffer);
     return E_SUCCESS;
 }
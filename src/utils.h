@@ -53,6 +53,15 @@ enum error_t
     E_READ_LIMIT,
     E_WRITE_LIMIT,
     E_FILE_CLOSED,
+    E_HEAP_CORRUPT,
+    E_AIO_PENDING,
+    E_AIO_ID,
+    E_AIO_FULL,
+    E_NO_ALARM,
+    E_BLOCKED, // the caller has been put to sleep and must retry
+    E_DEVICE_REGISTRY_FULL,
+    E_LED_LEVEL,
+    E_LINE_TOO_LONG,
     E_COUNT // E_COUNT must be last to calculate the total number of error types
 };
 
@@ -0,0 +1,56 @@
+/**
+ * waitq.c
+ * Kernel wait queues for blocking until an event occurs
+ *
+ * Author: James Nicholson
+ */
+
+#include "waitq.h"
+#include <stddef.h>
+
+/**
+ * Implementation Notes
+ *
+ * A blocked process is linked into its wait queue through pcb->next, the
+ * same link the run queue uses, since a process is never on both. Waking
+ * moves every sleeper back to the run queue and lets each one re-test its
+ * own condition, which keeps the interrupt handlers that wake them short.
+ */
+
+void waitq_block(struct wait_queue *wq)
+{
+    struct pcb *p = currentPCB;
+    p->state = PROC_BLOCKED;
+    p->next = NULL;
+    if (wq->tail == NULL)
+    {
+        wq->head = p;
+    }
+    else
+    {
+        wq->tail->next = p;
+    }
+    wq->tail = p;
+    proc_yield();
+}
+
+void waitq_wake_all(struct wait_queue *wq)
+{
+    uint32_t primask = proc_irq_save();
+    struct pcb *p = wq->head;
+    wq->head = NULL;
+    wq->tail = NULL;
+    int woke = p != NULL;
+    while (p != NULL)
+    {
+        struct pcb *next = p->next;
+        sched_ready(&kernel_sched, p);
+        p = next;
+    }
+    // Don't make idle wait for the next tick to give up the CPU.
+    if (woke && kernel_sched.current == kernel_sched.idle)
+    {
+        proc_yield();
+    }
+    proc_irq_restore(primask);
+}
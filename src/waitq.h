@@ -0,0 +1,96 @@
+/**
+ * waitq.h
+ * Kernel wait queues for blocking until an event occurs
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _WAITQ_H
+#define _WAITQ_H
+
+#include <stddef.h>
+#include "pcb.h"
+#include "proc.h"
+#include "utils.h"
+
+struct wait_queue
+{
+    struct pcb *head;
+    struct pcb *tail;
+};
+
+#define WAIT_QUEUE_INIT {NULL, NULL}
+
+/**
+ * Put the running process to sleep on wq and request a context switch. The
+ * switch happens once interrupts are unmasked, so the caller must hold them
+ * masked (proc_irq_save) from testing its wakeup condition until it is
+ * ready to give up the CPU. Use WAIT_EVENT rather than calling this directly.
+ */
+void waitq_block(struct wait_queue *wq);
+
+/**
+ * Make every process sleeping on wq ready to run. Safe to call from an
+ * interrupt handler.
+ */
+void waitq_wake_all(struct wait_queue *wq);
+
+/**
+ * Wait until cond is true. A process running in thread mode sleeps on wq
+ * and is woken by whoever calls waitq_wake_all(wq) after making cond true.
+ * Before the scheduler starts, or inside a handler, where there is nothing
+ * to switch to, it polls cond instead. cond is evaluated with interrupts
+ * masked, so it may safely arm the interrupt that will wake the process.
+ */
+#define WAIT_EVENT(wq, cond) \
+    do \
+    { \
+        uint32_t _wait_primask = proc_irq_save(); \
+        if (proc_can_block()) \
+        { \
+            while (!(cond)) \
+            { \
+                waitq_block(wq); \
+                proc_irq_restore(_wait_primask); \
+                _wait_primask = proc_irq_save(); \
+            } \
+            proc_irq_restore(_wait_primask); \
+        } \
+        else \
+        { \
+            proc_irq_restore(_wait_primask); \
+            while (!(cond)) \
+            { \
+            } \
+        } \
+    } while (0)
+
+/**
+ * WAIT_EVENT for device code, which runs either in a process or in the SVC
+ * handler on a process's behalf. An SVC handler can't sleep, so there, if
+ * cond is false, the calling process is put to sleep on wq and status is set
+ * to E_BLOCKED; the device must then return E_BLOCKED without having changed
+ * anything, and the SVC is run again from the start once the process wakes.
+ * Otherwise this waits as WAIT_EVENT does and sets status to E_SUCCESS.
+ */
+#define WAIT_EVENT_SVC(wq, cond, status) \
+    do \
+    { \
+        (status) = E_SUCCESS; \
+        if (proc_in_svc()) \
+        { \
+            uint32_t _wait_primask = proc_irq_save(); \
+            if (!(cond)) \
+            { \
+                waitq_block(wq); \
+                (status) = E_BLOCKED; \
+            } \
+            proc_irq_restore(_wait_primask); \
+        } \
+        else \
+        { \
+            WAIT_EVENT(wq, cond); \
+        } \
+    } while (0)
+
+#endif /* ifndef _WAITQ_H */
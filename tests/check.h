@@ -0,0 +1,39 @@
+/**
+ * check.h
+ * Minimal assertions for the host tests
+ *
+ * Author: James Nicholson
+ */
+
+#ifndef _CHECK_H
+#define _CHECK_H
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+/**
+ * Record a failure, with where it happened, if cond is false. Unlike
+ * assert, the test carries on so one run reports every failure.
+ */
+#define CHECK(cond)                                                          \
+    do                                                                       \
+    {                                                                        \
+        if (!(cond))                                                         \
+        {                                                                    \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            check_failures++;                                                \
+        }                                                                    \
+    } while (0)
+
+/**
+ * Report the result of the test program named name.
+ * Returns: the exit status for main
+ */
+static int check_report(const char *name)
+{
+    printf("%s: %s\n", name, check_failures == 0 ? "PASS" : "FAIL");
+    return check_failures == 0 ? 0 : 1;
+}
+
+#endif /* ifndef _CHECK_H */
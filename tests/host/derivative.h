@@ -0,0 +1,7 @@
+/**
+ * derivative.h
+ * Host stand-in for the K70 register definitions. The modules built by the
+ * host tests include it only by way of devinio.h and use nothing from it.
+ *
+ * Author: James Nicholson
+ */
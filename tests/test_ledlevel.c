@@ -0,0 +1,67 @@
+/**
+ * test_ledlevel.c
+ * Host tests for parsing LED brightness levels
+ *
+ * Author: James Nicholson
+ */
+
+#include "ledlevel.h"
+#include "utils.h"
+#include "check.h"
+#include <string.h>
+
+/**
+ * Every form an LED level may be written in, and the ones that must be
+ * refused.
+ */
+static void test_parse(void)
+{
+    const char *good[] = {"on", "off", "0%", "50%", "100", "7\n", "on\n"};
+    uint32_t want[] = {100, 0, 0, 50, 100, 7, 100};
+    const char *bad[] = {"", "%", "101%", "1000", "5x%", "onn", "-1", "\n"};
+    uint32_t percent;
+    for (int i = 0; i < sizeof(good) / sizeof(good[0]); i++)
+    {
+        percent = 999;
+        CHECK(led_level_parse(good[i], strlen(good[i]) + 1, &percent) == E_SUCCESS);
+        CHECK(percent == want[i]);
+    }
+    for (int i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        percent = 999;
+        CHECK(led_level_parse(bad[i], strlen(bad[i]) + 1, &percent) == E_LED_LEVEL);
+        CHECK(percent == 999);
+    }
+}
+
+/**
+ * A buffer without a NUL ends at its length, and one with a NUL ends there.
+ */
+static void test_parse_length(void)
+{
+    uint32_t percent;
+    CHECK(led_level_parse("25%%", 3, &percent) == E_SUCCESS && percent == 25);
+    CHECK(led_level_parse("100", 2, &percent) == E_SUCCESS && percent == 10);
+    CHECK(led_level_parse("off\0junk", 9, &percent) == E_SUCCESS && percent == 0);
+}
+
+/**
+ * Duty cycles round to the nearest count and reach both ends of the period.
+ */
+static void test_counts(void)
+{
+    CHECK(led_level_counts(0, 60000) == 0);
+    CHECK(led_level_counts(100, 60000) == 60000);
+    CHECK(led_level_counts(33, 1000) == 330);
+    CHECK(led_level_counts(1, 50) == 1);
+    CHECK(led_level_counts(1, 49) == 0);
+    CHECK(led_level_counts(50, 3) == 2);
+}
+
+int main(void)
+{
+    test_parse();
+    test_parse_length();
+    test_counts();
+    return check_report("ledlevel");
+}
@@ -0,0 +1,96 @@
+/**
+ * test_ringbuf.c
+ * Host tests for the byte ring buffer
+ *
+ * Author: James Nicholson
+ */
+
+#include "ringbuf.h"
+#include "check.h"
+#include <string.h>
+
+/**
+ * Fill, drain and wrap a small ring buffer through both the byte and the
+ * bulk interfaces.
+ */
+static void test_fill_and_wrap(void)
+{
+    uint8_t storage[8];
+    uint8_t out[8];
+    struct ringbuf rb;
+    ringbuf_init(&rb, storage, sizeof(storage));
+    uint8_t c;
+    CHECK(ringbuf_get(&rb, &c) == 0);
+    CHECK(ringbuf_count(&rb) == 0 && ringbuf_space(&rb) == 8);
+    for (int i = 0; i < 8; i++)
+    {
+        CHECK(ringbuf_put(&rb, 'a' + i) == 1);
+    }
+    CHECK(ringbuf_put(&rb, 'z') == 0);
+    CHECK(ringbuf_count(&rb) == 8 && ringbuf_space(&rb) == 0);
+    // Take five so the next bulk write wraps past the end of storage.
+    CHECK(ringbuf_read(&rb, out, 5) == 5 && memcmp(out, "abcde", 5) == 0);
+    CHECK(ringbuf_write(&rb, (const uint8_t *)"123456", 6) == 5);
+    CHECK(ringbuf_read(&rb, out, sizeof(out)) == 8 && memcmp(out, "fgh12345", 8) == 0);
+    CHECK(ringbuf_count(&rb) == 0 && ringbuf_get(&rb, &c) == 0);
+}
+
+/**
+ * head and tail are free running, so the buffer must keep working when
+ * they wrap past 2^32.
+ */
+static void test_index_wrap(void)
+{
+    uint8_t storage[4];
+    uint8_t out[4];
+    struct ringbuf rb;
+    ringbuf_init(&rb, storage, sizeof(storage));
+    rb.head = rb.tail = 0xFFFFFFFEu;
+    CHECK(ringbuf_write(&rb, (const uint8_t *)"wxyz", 4) == 4);
+    CHECK(rb.head == 2 && ringbuf_count(&rb) == 4 && ringbuf_space(&rb) == 0);
+    CHECK(ringbuf_put(&rb, 'q') == 0);
+    uint8_t c;
+    CHECK(ringbuf_get(&rb, &c) == 1 && c == 'w');
+    CHECK(ringbuf_read(&rb, out, 4) == 3 && memcmp(out, "xyz", 3) == 0);
+    CHECK(ringbuf_count(&rb) == 0 && ringbuf_space(&rb) == 4);
+}
+
+/**
+ * Bytes come out in the order they went in however the reads and writes
+ * are sized.
+ */
+static void test_stream(void)
+{
+    uint8_t storage[16];
+    struct ringbuf rb;
+    ringbuf_init(&rb, storage, sizeof(storage));
+    uint8_t in = 0;
+    uint8_t expect = 0;
+    for (int round = 0; round < 1000; round++)
+    {
+        uint8_t buf[16];
+        uint32_t want = 1 + round % 13;
+        for (uint32_t i = 0; i < want; i++)
+        {
+            buf[i] = in + i;
+        }
+        uint32_t wrote = ringbuf_write(&rb, buf, want);
+        CHECK(wrote <= want);
+        in += wrote;
+        uint32_t got = ringbuf_read(&rb, buf, 1 + round % 7);
+        for (uint32_t i = 0; i < got; i++)
+        {
+            CHECK(buf[i] == expect);
+            expect++;
+        }
+        CHECK(ringbuf_count(&rb) == (uint8_t)(in - expect));
+    }
+}
+
+int main(void)
+{
+    test_fill_and_wrap();
+    test_index_wrap();
+    test_stream();
+    return check_report("ringbuf");
+}
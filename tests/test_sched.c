@@ -0,0 +1,140 @@
+/**
+ * test_sched.c
+ * Host tests for the run queue and time slice accounting
+ *
+ * Author: James Nicholson
+ */
+
+#include "sched.h"
+#include "check.h"
+
+struct pcb *currentPCB;
+
+static struct pcb procs[4];
+static struct pcb *idle = &procs[3];
+
+static void make_procs(void)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        procs[i].pid = i + 1;
+        procs[i].state = PROC_BLOCKED;
+        procs[i].ticks = 0;
+        procs[i].next = NULL;
+    }
+}
+
+/**
+ * Tick s once, switching if it asks to.
+ */
+static void tick(struct scheduler *s)
+{
+    if (sched_tick(s))
+    {
+        sched_switch(s);
+    }
+}
+
+/**
+ * Three processes with a two tick quantum take turns in order, blocked and
+ * exited processes drop out of the rotation, and idle only runs until
+ * something is ready.
+ */
+static void test_round_robin(void)
+{
+    make_procs();
+    struct scheduler s;
+    sched_init(&s, &procs[0], idle, 2);
+    sched_ready(&s, &procs[1]);
+    sched_ready(&s, &procs[2]);
+    // pid running during each tick
+    int expected[13] = {1, 1, 2, 2, 3, 3, 1, 2, 2, 3, 2, 4, 1};
+    for (int t = 0; t < 13; t++)
+    {
+        CHECK(s.current->pid == expected[t]);
+        CHECK(s.current->state == PROC_RUNNING);
+        if (t == 6)
+        {
+            s.current->state = PROC_BLOCKED;
+        }
+        if (t == 9)
+        {
+            s.current->state = PROC_EXITED;
+        }
+        if (t == 10)
+        {
+            s.current->state = PROC_BLOCKED;
+        }
+        if (t == 11)
+        {
+            sched_ready(&s, &procs[0]);
+        }
+        tick(&s);
+    }
+    CHECK(s.ticks == 13);
+    CHECK(procs[0].ticks == 4 && procs[1].ticks == 5 && procs[2].ticks == 3 && idle->ticks == 1);
+}
+
+/**
+ * A process alone keeps the CPU past the end of its slice, and is switched
+ * out as soon as another is ready and the slice is over.
+ */
+static void test_alone(void)
+{
+    make_procs();
+    struct scheduler s;
+    sched_init(&s, &procs[0], idle, 3);
+    for (int t = 0; t < 10; t++)
+    {
+        CHECK(sched_tick(&s) == 0);
+    }
+    sched_ready(&s, &procs[1]);
+    CHECK(sched_tick(&s) == 1);
+    CHECK(sched_switch(&s) == &procs[1]);
+    CHECK(procs[0].state == PROC_READY && s.head == &procs[0] && s.tail == &procs[0]);
+}
+
+/**
+ * Readying a process twice, readying the running process, or readying idle
+ * must not put anything on the queue twice.
+ */
+static void test_ready_twice(void)
+{
+    make_procs();
+    struct scheduler s;
+    sched_init(&s, &procs[0], idle, 2);
+    sched_ready(&s, &procs[1]);
+    sched_ready(&s, &procs[1]);
+    sched_ready(&s, &procs[0]);
+    sched_ready(&s, idle);
+    CHECK(s.head == &procs[1] && s.tail == &procs[1] && procs[1].next == NULL);
+    CHECK(procs[0].state == PROC_RUNNING && idle->state == PROC_BLOCKED);
+}
+
+/**
+ * With nothing ready, a process that blocks hands over to idle, and idle
+ * gives way on the next tick once something is ready.
+ */
+static void test_idle(void)
+{
+    make_procs();
+    struct scheduler s;
+    sched_init(&s, &procs[0], idle, 2);
+    procs[0].state = PROC_BLOCKED;
+    CHECK(sched_tick(&s) == 1);
+    CHECK(sched_switch(&s) == idle);
+    CHECK(sched_tick(&s) == 0);
+    sched_ready(&s, &procs[0]);
+    CHECK(sched_tick(&s) == 1);
+    CHECK(sched_switch(&s) == &procs[0]);
+    CHECK(s.head == NULL && s.tail == NULL);
+}
+
+int main(void)
+{
+    test_round_robin();
+    test_alone();
+    test_ready_twice();
+    test_idle();
+    return check_report("sched");
+}
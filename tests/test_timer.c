@@ -0,0 +1,106 @@
+/**
+ * test_timer.c
+ * Host tests for the timer wheel
+ *
+ * Author: James Nicholson
+ */
+
+#include "timer.h"
+#include "check.h"
+
+static struct timer_wheel wheel;
+
+static void record_expiry(struct timer *t)
+{
+    *(uint32_t *)t->arg = wheel.now;
+}
+
+/**
+ * Timers at each level of the wheel, and across the boundaries between
+ * levels, must expire on exactly their tick; cancelled timers never.
+ */
+static void test_levels(void)
+{
+    uint32_t delays[8] = {1, 63, 64, 65, 4095, 4096, 5000, 300000};
+    struct timer timers[9];
+    uint32_t fired[9];
+    timer_wheel_init(&wheel);
+    // Start part way through a level 1 slot so timers don't line up with it
+    wheel.now = 4000;
+    for (int i = 0; i < 9; i++)
+    {
+        fired[i] = 0;
+        timer_init(&timers[i], record_expiry, &fired[i]);
+        CHECK(!timer_pending(&timers[i]));
+    }
+    for (int i = 0; i < 8; i++)
+    {
+        timer_add(&wheel, &timers[i], 4000 + delays[i]);
+        CHECK(timer_pending(&timers[i]));
+    }
+    timer_add(&wheel, &timers[8], 4100);
+    timer_cancel(&timers[8]);
+    CHECK(!timer_pending(&timers[8]));
+    // Moving a pending timer must take it out of its old slot
+    timer_add(&wheel, &timers[2], 4000 + 70);
+    delays[2] = 70;
+    for (int t = 0; t < 300001; t++)
+    {
+        timer_wheel_tick(&wheel);
+    }
+    for (int i = 0; i < 8; i++)
+    {
+        CHECK(fired[i] == 4000 + delays[i]);
+        CHECK(!timer_pending(&timers[i]));
+    }
+    CHECK(fired[8] == 0);
+}
+
+static uint32_t periodic_count;
+
+static void rearm(struct timer *t)
+{
+    periodic_count++;
+    timer_add(&wheel, t, t->expires + 10);
+}
+
+/**
+ * A callback may add its own timer again, as alarms do.
+ */
+static void test_rearm(void)
+{
+    struct timer t;
+    timer_wheel_init(&wheel);
+    timer_init(&t, rearm, NULL);
+    periodic_count = 0;
+    timer_add(&wheel, &t, 10);
+    for (int i = 0; i < 100; i++)
+    {
+        timer_wheel_tick(&wheel);
+    }
+    CHECK(periodic_count == 10);
+    CHECK(timer_pending(&t) && t.expires == 110);
+}
+
+/**
+ * A time already passed expires on the next tick.
+ */
+static void test_past(void)
+{
+    struct timer t;
+    uint32_t fired = 0;
+    timer_wheel_init(&wheel);
+    wheel.now = 500;
+    timer_init(&t, record_expiry, &fired);
+    timer_add(&wheel, &t, 100);
+    timer_wheel_tick(&wheel);
+    CHECK(fired == 501);
+}
+
+int main(void)
+{
+    test_levels();
+    test_rearm();
+    test_past();
+    return check_report("timer");
+}